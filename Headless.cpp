@@ -0,0 +1,673 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "Simulation/Simulation.h"
+#include "Simulation/Scenario.h"
+#include "Simulation/CentralGravity.h"
+#include "Simulation/DirectGravity.h"
+#include "Simulation/BarnesHutGravity.h"
+#include "Simulation/FmmGravity.h"
+#include "Simulation/PMGravity.h"
+#include "Simulation/P3MGravity.h"
+#include "Simulation/MassiveBodyGravity.h"
+#include "Simulation/Parallel.h"
+#include "Simulation/EulerIntegrator.h"
+#include "Simulation/BlockTimestepIntegrator.h"
+#include "Simulation/WisdomHolmanIntegrator.h"
+#include "Simulation/KeplerPropagator.h"
+#include "Simulation/SymplecticIntegrator.h"
+#include "Simulation/HermiteIntegrator.h"
+#include "Simulation/Ias15Integrator.h"
+#include "Simulation/RegularizedIntegrator.h"
+#include "Simulation/Softening.h"
+#include "Simulation/Diagnostics.h"
+
+// --------------------- HEADLESS DRIVER ---------------------
+// Runs the simulation without a window so it can be profiled and used on render-less batch nodes.
+// Usage: GravityHeadless [--particles N] [--steps S] [--dt DT] [--solver NAME] [--scenario NAME] [--softening EPS] [--compare]
+//                        [--theta T] [--quadrupole] [--order P] [--grid G] [--box L] [--split S] [--threads N]
+//                        [--integrator NAME] [--eta E] [--levels L] [--kernel NAME] [--encounter R] [--min-step F] [--max-steps N]
+//                        [--mixed] [--energy] [--check-determinism] [--reorder N]
+
+struct Options
+{
+	std::size_t particles = 100;
+	int steps = 1000;
+	float dt = 0.25f;
+	std::string solver = "central";
+	std::string scenario = "default";
+	float softening = 0.0f;
+	SofteningKernel kernel = SOFTENING_PLUMMER;
+	// Barnes-Hut opening angle
+	float theta = 0.5f;
+	bool quadrupole = false;
+	// FMM expansion order
+	unsigned int order = 4;
+	// Particle-mesh cells per side and periodic box size (0 for isolated)
+	unsigned int grid = 64;
+	float box = 0.0f;
+	// P3M force split scale in mesh cells
+	float split = 1.25f;
+	std::string integrator = "euler";
+	// Timestep accuracy parameter and deepest time bin of the block timestep integrators, 0 keeps their defaults
+	float eta = 0.0f;
+	unsigned int levels = 0;
+	// Shortest IAS15 internal step as a fraction of dt and internal steps allowed per step, 0 keeps its defaults
+	double minStep = 0.0;
+	unsigned int maxSteps = 0;
+	// Distance from the sun inside which the regularized integrator switches to KS coordinates, 0 keeps its default
+	float encounter = 0.0f;
+	// Keeps positions and velocities in double, forces stay in float
+	bool mixed = false;
+	// Steps between Z-order re-sorts of the particles, 0 never re-sorts
+	unsigned int reorder = 0;
+	// 0 uses every hardware thread
+	unsigned int threads = 0;
+	// Checks one force evaluation against a naive all-pairs loop before running
+	bool compare = false;
+	// Reports energy and momentum before and after the run
+	bool energy = false;
+	// Checks that one force evaluation gives the same bits on one thread as on all of them
+	bool checkDeterminism = false;
+};
+
+void printUsage()
+{
+	std::cout << "Usage: GravityHeadless [--particles N] [--steps S] [--dt DT] [--solver NAME] [--scenario NAME] [--softening EPS] [--compare]" << std::endl;
+	std::cout << "                       [--theta T] [--quadrupole] [--order P] [--grid G] [--box L] [--split S] [--threads N]" << std::endl;
+	std::cout << "                       [--integrator NAME] [--eta E] [--levels L] [--kernel NAME] [--encounter R] [--min-step F] [--max-steps N]" << std::endl;
+	std::cout << "                       [--mixed] [--energy] [--check-determinism] [--reorder N]" << std::endl;
+	std::cout << "Solvers: central, direct, massive, barnes-hut, fmm, pm, p3m" << std::endl;
+	std::cout << "Scenarios: default, disk, debris, uniform, plummer" << std::endl;
+	std::cout << "Integrators: euler, block, wisdom-holman, kepler, leapfrog-kdk, leapfrog-dkd, forest-ruth, yoshida4, yoshida6, hermite, ias15, regularized" << std::endl;
+	std::cout << "Softening kernels: plummer, spline" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--particles" && hasValue)
+		{
+			options.particles = std::strtoull(argv[++i], NULL, 10);
+		}
+		else if (arg == "--steps" && hasValue)
+		{
+			options.steps = std::atoi(argv[++i]);
+		}
+		else if (arg == "--dt" && hasValue)
+		{
+			options.dt = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--solver" && hasValue)
+		{
+			options.solver = argv[++i];
+		}
+		else if (arg == "--scenario" && hasValue)
+		{
+			options.scenario = argv[++i];
+		}
+		else if (arg == "--softening" && hasValue)
+		{
+			options.softening = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--kernel" && hasValue)
+		{
+			if (!parseSofteningKernel(argv[++i], options.kernel))
+			{
+				return false;
+			}
+		}
+		else if (arg == "--encounter" && hasValue)
+		{
+			options.encounter = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--mixed")
+		{
+			options.mixed = true;
+		}
+		else if (arg == "--compare")
+		{
+			options.compare = true;
+		}
+		else if (arg == "--energy")
+		{
+			options.energy = true;
+		}
+		else if (arg == "--check-determinism")
+		{
+			options.checkDeterminism = true;
+		}
+		else if (arg == "--theta" && hasValue)
+		{
+			options.theta = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--quadrupole")
+		{
+			options.quadrupole = true;
+		}
+		else if (arg == "--order" && hasValue)
+		{
+			options.order = static_cast<unsigned int>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--grid" && hasValue)
+		{
+			options.grid = static_cast<unsigned int>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--box" && hasValue)
+		{
+			options.box = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--split" && hasValue)
+		{
+			options.split = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--integrator" && hasValue)
+		{
+			options.integrator = argv[++i];
+		}
+		else if (arg == "--eta" && hasValue)
+		{
+			options.eta = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--levels" && hasValue)
+		{
+			options.levels = static_cast<unsigned int>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--min-step" && hasValue)
+		{
+			options.minStep = std::atof(argv[++i]);
+		}
+		else if (arg == "--max-steps" && hasValue)
+		{
+			options.maxSteps = static_cast<unsigned int>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--reorder" && hasValue)
+		{
+			options.reorder = static_cast<unsigned int>(std::atoi(argv[++i]));
+		}
+		else if (arg == "--threads" && hasValue)
+		{
+			options.threads = static_cast<unsigned int>(std::atoi(argv[++i]));
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return options.particles > 0 && options.steps >= 0;
+}
+
+std::unique_ptr<ForceSolver> makeForceSolver(const Options& options)
+{
+	const std::string& name = options.solver;
+
+	if (name == "central")
+	{
+		return std::unique_ptr<ForceSolver>(new CentralGravity(options.softening, options.kernel));
+	}
+	if (name == "direct")
+	{
+		return std::unique_ptr<ForceSolver>(new DirectGravity(options.softening, options.kernel));
+	}
+	if (name == "barnes-hut")
+	{
+		BarnesHutGravity* barnesHut = new BarnesHutGravity(options.theta, options.quadrupole, options.softening);
+		barnesHut->softeningKernel = options.kernel;
+		return std::unique_ptr<ForceSolver>(barnesHut);
+	}
+	if (name == "fmm")
+	{
+		FmmGravity* fmm = new FmmGravity(options.order, options.theta, options.softening);
+		fmm->softeningKernel = options.kernel;
+		return std::unique_ptr<ForceSolver>(fmm);
+	}
+	if (name == "massive")
+	{
+		return std::unique_ptr<ForceSolver>(new MassiveBodyGravity(options.softening, options.kernel));
+	}
+	if (name == "pm")
+	{
+		return std::unique_ptr<ForceSolver>(new PMGravity(options.grid, options.box));
+	}
+	if (name == "p3m")
+	{
+		P3MGravity* p3m = new P3MGravity(options.grid, options.box, options.split);
+		p3m->softening = options.softening;
+		p3m->softeningKernel = options.kernel;
+		return std::unique_ptr<ForceSolver>(p3m);
+	}
+
+	return nullptr;
+}
+
+// Instantiates the scheme together with the concrete solver class when there is one, so forces are computed without
+// going through the ForceSolver vtable
+template <class Scheme>
+std::unique_ptr<Integrator> makeSymplecticIntegrator(const Options& options)
+{
+	if (options.solver == "central")
+	{
+		return std::unique_ptr<Integrator>(new SymplecticIntegrator<Scheme, CentralGravity>());
+	}
+	if (options.solver == "direct")
+	{
+		return std::unique_ptr<Integrator>(new SymplecticIntegrator<Scheme, DirectGravity>());
+	}
+	if (options.solver == "massive")
+	{
+		return std::unique_ptr<Integrator>(new SymplecticIntegrator<Scheme, MassiveBodyGravity>());
+	}
+	return std::unique_ptr<Integrator>(new SymplecticIntegrator<Scheme>());
+}
+
+std::unique_ptr<Integrator> makeIntegrator(const Options& options)
+{
+	const std::string& name = options.integrator;
+
+	if (name == "euler")
+	{
+		return std::unique_ptr<Integrator>(new EulerIntegrator());
+	}
+	if (name == "block")
+	{
+		BlockTimestepIntegrator* block = new BlockTimestepIntegrator();
+		block->eta = options.eta > 0.0f ? options.eta : block->eta;
+		block->maxLevel = options.levels > 0 ? options.levels : block->maxLevel;
+		return std::unique_ptr<Integrator>(block);
+	}
+	if (name == "hermite")
+	{
+		HermiteIntegrator* hermite = new HermiteIntegrator(options.softening);
+		hermite->eta = options.eta > 0.0f ? options.eta : hermite->eta;
+		hermite->maxLevel = options.levels > 0 ? options.levels : hermite->maxLevel;
+		return std::unique_ptr<Integrator>(hermite);
+	}
+	if (name == "ias15")
+	{
+		Ias15Integrator* ias15 = new Ias15Integrator(options.softening, options.kernel);
+		ias15->minStep = options.minStep > 0.0 ? options.minStep : ias15->minStep;
+		ias15->maxSteps = options.maxSteps > 0 ? options.maxSteps : ias15->maxSteps;
+		return std::unique_ptr<Integrator>(ias15);
+	}
+	if (name == "regularized")
+	{
+		RegularizedIntegrator* regularized = new RegularizedIntegrator();
+		regularized->encounterRadius = options.encounter > 0.0f ? options.encounter : regularized->encounterRadius;
+		return std::unique_ptr<Integrator>(regularized);
+	}
+	if (name == "wisdom-holman")
+	{
+		return std::unique_ptr<Integrator>(new WisdomHolmanIntegrator());
+	}
+	if (name == "kepler")
+	{
+		return std::unique_ptr<Integrator>(new KeplerPropagator());
+	}
+	if (name == LeapfrogKDK::NAME)
+	{
+		return makeSymplecticIntegrator<LeapfrogKDK>(options);
+	}
+	if (name == LeapfrogDKD::NAME)
+	{
+		return makeSymplecticIntegrator<LeapfrogDKD>(options);
+	}
+	if (name == ForestRuth::NAME)
+	{
+		return makeSymplecticIntegrator<ForestRuth>(options);
+	}
+	if (name == Yoshida4::NAME)
+	{
+		return makeSymplecticIntegrator<Yoshida4>(options);
+	}
+	if (name == Yoshida6::NAME)
+	{
+		return makeSymplecticIntegrator<Yoshida6>(options);
+	}
+
+	return nullptr;
+}
+
+// Integrators that sum their own forces in double and never call the solver
+bool integratorSumsForces(const Options& options)
+{
+	return options.integrator == "hermite" || options.integrator == "ias15";
+}
+
+// Integrators that take the sun's pull exactly and only soften the mutual forces
+bool integratorKeepsSunExact(const Options& options)
+{
+	return options.integrator == "regularized" || options.integrator == "wisdom-holman";
+}
+
+// Integrators that move particles through ParticleStore::kick/drift, the only ones --mixed applies to. The others
+// write the float arrays directly: ias15, wisdom-holman and kepler keep their own double state, hermite and
+// regularized are float throughout.
+bool integratorSupportsMixed(const Options& options)
+{
+	static const char* const direct[] = { "hermite", "ias15", "regularized", "wisdom-holman", "kepler" };
+	for (const char* name : direct)
+	{
+		if (options.integrator == name)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Softening of the forces actually integrated, so energy and the naive comparison measure those forces.
+// The particle-mesh solver has no softening parameter, the mesh itself smooths the force below a cell.
+float appliedSoftening(const Options& options)
+{
+	return options.solver == "pm" && !integratorSumsForces(options) ? 0.0f : options.softening;
+}
+
+// Says which options the chosen solver and integrator do not use, rather than dropping them silently
+void printIgnoredOptions(const Options& options)
+{
+	if (options.solver == "pm" && !integratorSumsForces(options) && (options.softening != 0.0f || options.kernel != SOFTENING_PLUMMER))
+	{
+		std::cout << "Note: pm forces are smoothed by the mesh, --softening and --kernel are ignored and energy is measured unsoftened" << std::endl;
+	}
+	if (options.mixed && !integratorSupportsMixed(options))
+	{
+		std::cout << "Note: " << options.integrator << " updates the float state directly, --mixed is ignored" << std::endl;
+	}
+	if (integratorKeepsSunExact(options) && options.softening != 0.0f)
+	{
+		std::cout << "Note: " << options.integrator << " never softens the sun's pull, --softening only applies to the mutual forces" << std::endl;
+	}
+	if (integratorSumsForces(options) && options.solver != "central")
+	{
+		std::cout << "Note: " << options.integrator << " sums forces directly, --solver " << options.solver << " is ignored" << std::endl;
+	}
+}
+
+bool buildScenario(const Options& options, ParticleStore& particles)
+{
+	if (options.scenario == "default")
+	{
+		buildDefaultScenario(particles, options.particles);
+	}
+	else if (options.scenario == "disk")
+	{
+		buildDiskScenario(particles, options.particles);
+	}
+	else if (options.scenario == "debris")
+	{
+		buildDebrisDiskScenario(particles, options.particles);
+	}
+	else if (options.scenario == "uniform")
+	{
+		buildUniformScenario(particles, options.particles);
+	}
+	else if (options.scenario == "plummer")
+	{
+		buildPlummerScenario(particles, options.particles);
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+// Times one solver evaluation against the textbook double loop over glm::vec3 and reports the worst relative error.
+// Above 20,000 particles the reference only runs for a sample of targets and its time is scaled up.
+void compareWithNaive(ParticleStore& particles, ForceSolver& solver, float softening, SofteningKernel kernel)
+{
+	std::size_t n = particles.size();
+	std::size_t targets = std::min<std::size_t>(n, n > 20000 ? 1000 : n);
+	std::size_t stride = n / targets;
+
+	std::vector<glm::vec3> positions(n);
+	std::vector<float> masses(n);
+	for (std::size_t i = 0; i < n; i++)
+	{
+		positions[i] = glm::vec3(particles.x[i], particles.y[i], particles.z[i]);
+		masses[i] = particles.mass[i];
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	solver.computeAccelerations(particles);
+	std::chrono::duration<double> solverTime = std::chrono::steady_clock::now() - start;
+
+	std::vector<glm::vec3> reference(targets);
+	start = std::chrono::steady_clock::now();
+	for (std::size_t t = 0; t < targets; t++)
+	{
+		std::size_t i = t * stride;
+		glm::vec3 acceleration(0.0f);
+		for (std::size_t j = 0; j < n; j++)
+		{
+			if (j == i)
+			{
+				continue;
+			}
+			glm::vec3 d = positions[j] - positions[i];
+			acceleration += d * (GRAVITATIONAL_CONSTANT * masses[j] * softenedForceFactor(glm::dot(d, d), softening, kernel));
+		}
+		reference[t] = acceleration;
+	}
+	std::chrono::duration<double> naiveTime = std::chrono::steady_clock::now() - start;
+	double naiveEstimate = naiveTime.count() * (double)n / targets;
+
+	double maxError = 0.0;
+	double sumError = 0.0;
+	for (std::size_t t = 0; t < targets; t++)
+	{
+		std::size_t i = t * stride;
+		glm::vec3 a(particles.ax[i], particles.ay[i], particles.az[i]);
+		float magnitude = glm::length(reference[t]);
+		if (magnitude > 0.0f)
+		{
+			double error = glm::length(a - reference[t]) / magnitude;
+			maxError = std::max(maxError, error);
+			sumError += error;
+		}
+	}
+
+	std::cout << "Solver force time: " << solverTime.count() << " s" << std::endl;
+	std::cout << "Naive force time: " << naiveEstimate << " s" << (targets < n ? " (estimated from sample)" : "") << std::endl;
+	if (solverTime.count() > 0.0)
+	{
+		std::cout << "Speedup: " << naiveEstimate / solverTime.count() << "x" << std::endl;
+	}
+	std::cout << "Relative error: mean " << sumError / targets << ", max " << maxError << std::endl;
+}
+
+// Evaluates the forces once on a single thread and once on every thread and compares the results bit for bit
+void checkDeterminism(ParticleStore& particles, ForceSolver& solver)
+{
+	unsigned int threads = threadCount();
+	std::size_t n = particles.size();
+
+	setThreadCount(1);
+	solver.computeAccelerations(particles);
+	std::vector<float> serial;
+	serial.insert(serial.end(), particles.ax.begin(), particles.ax.begin() + n);
+	serial.insert(serial.end(), particles.ay.begin(), particles.ay.begin() + n);
+	serial.insert(serial.end(), particles.az.begin(), particles.az.begin() + n);
+
+	setThreadCount(threads);
+	solver.computeAccelerations(particles);
+	std::size_t mismatches = 0;
+	for (std::size_t i = 0; i < n; i++)
+	{
+		mismatches += std::memcmp(&serial[i], &particles.ax[i], sizeof(float)) != 0;
+		mismatches += std::memcmp(&serial[n + i], &particles.ay[i], sizeof(float)) != 0;
+		mismatches += std::memcmp(&serial[2 * n + i], &particles.az[i], sizeof(float)) != 0;
+	}
+
+	std::cout << "Deterministic (1 vs " << threads << " threads): " << (mismatches == 0 ? "yes" : "no") << std::endl;
+	if (mismatches > 0)
+	{
+		std::cout << "Mismatched components: " << mismatches << std::endl;
+	}
+}
+
+void printConserved(const char* label, const ConservedQuantities& conserved)
+{
+	std::cout << label << " energy: " << conserved.energy() << ", momentum: (" << conserved.momentum[0] << ", "
+		<< conserved.momentum[1] << ", " << conserved.momentum[2] << ")" << std::endl;
+}
+
+// FNV-1a over the bits of every position and velocity, equal hashes mean bit-identical runs
+std::uint64_t stateHash(const ParticleStore& particles)
+{
+	// Visits particles by id so a re-sorted store hashes the same as an unsorted one with the same state
+	std::vector<std::size_t> slots(particles.size());
+	for (std::size_t i = 0; i < particles.size(); i++)
+	{
+		slots[particles.ids[i]] = i;
+	}
+
+	std::uint64_t hash = 14695981039346656037ull;
+	const AlignedVector<float>* arrays[] = { &particles.x, &particles.y, &particles.z, &particles.vx, &particles.vy, &particles.vz };
+	for (const AlignedVector<float>* a : arrays)
+	{
+		for (std::size_t slot : slots)
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &(*a)[slot], sizeof(bits));
+			for (int b = 0; b < 4; b++)
+			{
+				hash = (hash ^ ((bits >> (8 * b)) & 0xFF)) * 1099511628211ull;
+			}
+		}
+	}
+	return hash;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return -1;
+	}
+	// The Hermite force and jerk kernel is Plummer only, there is no spline jerk
+	if (options.integrator == "hermite" && options.kernel != SOFTENING_PLUMMER)
+	{
+		std::cout << "The hermite integrator only supports --kernel plummer" << std::endl;
+		return -1;
+	}
+
+	setThreadCount(options.threads);
+	printIgnoredOptions(options);
+
+	std::unique_ptr<ForceSolver> solver = makeForceSolver(options);
+	if (!solver)
+	{
+		std::cout << "Unknown solver: " << options.solver << std::endl;
+		printUsage();
+		return -1;
+	}
+
+	std::unique_ptr<Integrator> integrator = makeIntegrator(options);
+	if (!integrator)
+	{
+		std::cout << "Unknown integrator: " << options.integrator << std::endl;
+		printUsage();
+		return -1;
+	}
+
+	Simulation simulation;
+	simulation.setForceSolver(std::move(solver));
+	simulation.setIntegrator(std::move(integrator));
+	if (!buildScenario(options, simulation.particles))
+	{
+		std::cout << "Unknown scenario: " << options.scenario << std::endl;
+		printUsage();
+		return -1;
+	}
+
+	const bool mixed = options.mixed && integratorSupportsMixed(options);
+	simulation.particles.setMixedPrecision(mixed);
+	simulation.reorderInterval = options.reorder;
+
+	std::cout << "Particles: " << simulation.particles.size() << std::endl;
+	std::cout << "Solver: " << simulation.forceSolver().name() << std::endl;
+	std::cout << "Integrator: " << simulation.integrator().name() << std::endl;
+	std::cout << "Precision: " << (mixed ? "mixed" : "float") << std::endl;
+	std::cout << "Direct kernel: " << DirectGravity::kernelName() << std::endl;
+	std::cout << "Threads: " << threadCount() << std::endl;
+	if (options.reorder > 0)
+	{
+		std::cout << "Z-order re-sort: every " << options.reorder << " steps" << std::endl;
+	}
+
+	if (options.compare)
+	{
+		compareWithNaive(simulation.particles, simulation.forceSolver(), appliedSoftening(options), options.kernel);
+	}
+	if (options.checkDeterminism)
+	{
+		checkDeterminism(simulation.particles, simulation.forceSolver());
+	}
+
+	ConservedQuantities initial = {};
+	if (options.energy)
+	{
+		initial = measureConserved(simulation.particles, appliedSoftening(options), options.kernel, !integratorKeepsSunExact(options));
+		printConserved("Initial", initial);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (int s = 0; s < options.steps; s++)
+	{
+		simulation.step(options.dt);
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	// Sum of positions so runs can be compared without dumping every particle
+	double checksum = 0.0;
+	for (std::size_t i = 0; i < simulation.particles.size(); i++)
+	{
+		checksum += simulation.particles.x[i] + simulation.particles.y[i] + simulation.particles.z[i];
+	}
+
+	std::cout << "Simulated time: " << simulation.time << std::endl;
+	std::cout << "Wall time: " << elapsed.count() << " s" << std::endl;
+	if (elapsed.count() > 0.0)
+	{
+		std::cout << "Steps per second: " << options.steps / elapsed.count() << std::endl;
+		std::cout << "Particle updates per second: " << options.steps * (double)simulation.particles.size() / elapsed.count() << std::endl;
+	}
+	if (options.steps > 0 && simulation.particles.size() > 0)
+	{
+		std::cout << "Force evaluations per particle per step: " << simulation.integrator().forceEvaluations / ((double)options.steps * simulation.particles.size()) << std::endl;
+	}
+	if (options.energy)
+	{
+		ConservedQuantities final = measureConserved(simulation.particles, appliedSoftening(options), options.kernel, !integratorKeepsSunExact(options));
+		printConserved("Final", final);
+		if (initial.energy() != 0.0)
+		{
+			std::cout << "Relative energy error: " << std::fabs((final.energy() - initial.energy()) / initial.energy()) << std::endl;
+		}
+	}
+	std::cout << "Position checksum: " << checksum << std::endl;
+	std::cout << "State hash: " << std::hex << stateHash(simulation.particles) << std::dec << std::endl;
+
+	return 0;
+}
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -10,6 +12,10 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Sphere.h"
+#include "ParticleRenderer.h"
+#include "Simulation/Simulation.h"
+#include "Simulation/Scenario.h"
+#include "Simulation/SimulationThread.h"
 
 int SCR_WIDTH = 1280;
 int SCR_HEIGHT = 720;
@@ -17,7 +23,6 @@ int SCR_HEIGHT = 720;
 void processInput(GLFWwindow* window);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xPosIn, double yPosIn);
-void gravity(glm::vec3& position, float strength, glm::vec3& speed, glm::vec3 gravityPos, float playSpeed);
 void scroll_callback(GLFWwindow* window, double xOffSet, double yOffSet);
 
 #include <random>
@@ -45,6 +50,29 @@ float lastFrame = 0.0f;
 float playingSpeed = 0.0f;
 bool rewindPlay = false;
 
+// --------------------- RENDERING ---------------------
+// Ray-cast impostors by default, I switches to the sphere meshes and back
+SphereStyle sphereStyle = SPHERE_IMPOSTOR;
+bool styleKeyHeld = false;
+
+// --------------------- SIMULATION THREAD ---------------------
+// Physics runs on its own thread, input reaches it through a queue
+SimulationThread* simulationThread = NULL;
+
+// Changes the playing speed and forwards it to the simulation thread
+void setPlayingSpeed(float speed)
+{
+	if (speed == playingSpeed)
+	{
+		return;
+	}
+	playingSpeed = speed;
+	if (simulationThread)
+	{
+		simulationThread->send(SimulationCommand{ SimulationCommand::SET_PLAYING_SPEED, playingSpeed });
+	}
+}
+
 int main()
 {
 
@@ -91,6 +119,9 @@ int main()
 		return -1;
 	}
 
+	// The instance buffer streams through persistently mapped memory where the driver supports it
+	StreamBuffer::loadBufferStorage((GLADloadproc)glfwGetProcAddress);
+
 	double previousTime = glfwGetTime();
 	int frameCount = 0;
 
@@ -98,19 +129,17 @@ int main()
 	                     // Shader Program //
 	// Creates a vertex & fragment shader and attaches it to the source code for the shader then compiles it
 	Shader ourShader("default.vert", "default.frag");
+	Shader impostorShader("impostor.vert", "impostor.frag");
 
 
 	// --------------------- VERTEX MANAGEMENT ---------------------
-	// Generates a Vertex Array Object & Sphere Objects and stores the vertices into them before sending them to the GPU
-	unsigned int VAO;
-	glGenVertexArrays(1, &VAO);
-
-	// Binds Vertex Array Object
-	glBindVertexArray(VAO);
-
-	// Creates the sphere models for dawing
-	Sphere particle(1.0f);
-	Sphere sun(5.0f);
+	// One unit sphere shared by every particle, each instance scales it to its own radius
+	Sphere sphere;
+	ParticleRenderer renderer(sphere);
+	const float particleRadius = 1.0f;
+	const float sunRadius = 5.0f;
+	// Level of detail picked for each particle this frame
+	std::vector<unsigned char> sphereLevels;
 
 	// --------------------- TRANSFORMATIONS ---------------------
 
@@ -121,56 +150,14 @@ int main()
 	glEnable(GL_DEPTH_TEST);
 
 	// Creates the positions and intiial velocities of the particles & sun
-	// Sun's coordinate is index 0 or (first in the array list)
-	glm::vec3 startPositions[100];
-
-	const int posNum = sizeof(startPositions) / sizeof(startPositions[0]);
-
-	glm::vec3 newPosition[posNum];
-
-	glm::vec3 initialVelocity[posNum];
-
-
-	for (int i = 0; i < posNum; i++)
-	{
-		float f = i;
-
-		if (i > 1000)
-		{
-			f = ((float)i / 1000) + 5.0f;
-		}
-
-		if (i > 100) 
-		{
-			f = ((float)i / 100) + 5.0f;
-		}
-
-		if (f > 50)
-		{
-			f = 100-f + 1.5f;
-		}
-
-		if (i % 2 == 0)
-		{
-			f *= -1;
-		}
+	// Sun's coordinate is index 0 (first in the particle store)
+	Simulation simulation;
+	buildDefaultScenario(simulation.particles, 100);
 
-		std::cout << f << std::endl;
-		startPositions[i] = glm::vec3(
-			50 * sin(f),
-			50 * cos(f),
-			0);
-		//startPositions[i] = glm::vec3(f);
-		
-	}
-
-	startPositions[0] = glm::vec3(0);
-
-	for (int i = 0; i < posNum; i++)
-	{
-		newPosition[i] = startPositions[i];
-		initialVelocity[i] = glm::vec3(sqrt(0.5), 0.0f, 0.0f);
-	}
+	// From here on only the simulation thread touches the simulation, the loop below draws its snapshots
+	SimulationThread physics(simulation);
+	simulationThread = &physics;
+	physics.start();
 
 	float time;
 
@@ -202,7 +189,8 @@ int main()
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Shader
-		ourShader.use();
+		Shader& sphereShader = sphereStyle == SPHERE_IMPOSTOR ? impostorShader : ourShader;
+		sphereShader.use();
 
 		// Creates the model, view & projection matrix
 		glm::mat4 projection = glm::mat4(1.0f);
@@ -212,65 +200,87 @@ int main()
 		view = camera.GetViewMatrix();
 		projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 10000.0f);
 
-		int viewLoc = glGetUniformLocation(ourShader.ID, "view");
-		int projectionLoc = glGetUniformLocation(ourShader.ID, "projection");
+		int viewLoc = glGetUniformLocation(sphereShader.ID, "view");
+		int projectionLoc = glGetUniformLocation(sphereShader.ID, "projection");
 
 		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &view[0][0]);
 		glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
 
-		// Drawing the sphere
-		for (unsigned int i = 0; i < posNum; i++)
-		{
-			unsigned int j = i;
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, newPosition[i]);
+		// Newest state published by the simulation thread, it keeps stepping while this frame is drawn
+		const SimulationSnapshot& particles = physics.latest();
+		const unsigned int posNum = static_cast<unsigned int>(particles.count);
+		// Physics runs in fixed steps, positions are blended between the last two so motion stays smooth at any frame rate
+		const float blend = particles.interpolationFactor(SimulationThread::clock());
 
-			if (i != 0)
-			{
-				gravity(newPosition[i], -50.0, initialVelocity[i], newPosition[0], playingSpeed);
+		// Drawing the spheres with one instanced draw call (per level for meshes). The instances are written straight
+		// into the mapped instance buffer.
+		ParticleInstance* instances = renderer.map(posNum);
 
-				glUniform3f(glGetUniformLocation(ourShader.ID, "ampColor"),
-					initialVelocity[i].x,
-					initialVelocity[i].y,
-					initialVelocity[i].z
-				);
+		// Meshes get a level of detail from their size on screen and are drawn one instanced call per level, so each
+		// level's instances must be written next to each other: count them first, then hand out slots bucket by bucket
+		std::size_t levelSlots[Sphere::lod_count] = {};
+		if (sphereStyle == SPHERE_MESH)
+		{
+			// Screen pixels covered by one unit at unit distance
+			const float pixelsPerUnit = SCR_HEIGHT * 0.5f / std::tan(glm::radians(45.0f) * 0.5f);
+			sphereLevels.resize(posNum);
+			for (unsigned int i = 0; i < posNum; i++)
+			{
+				float radius = i == 0 ? sunRadius : particleRadius;
+				float distance = glm::length(glm::vec3(particles.x[i], particles.y[i], particles.z[i]) - camera.Position);
+				sphereLevels[i] = static_cast<unsigned char>(sphere.levelFor(pixelsPerUnit * radius / std::max(distance, radius)));
+				levelSlots[sphereLevels[i]]++;
 			}
-			else
+			renderer.setLevelCounts(levelSlots);
+
+			std::size_t start = 0;
+			for (int level = 0; level < Sphere::lod_count; level++)
 			{
-				glUniform3f(glGetUniformLocation(ourShader.ID, "ampColor"),
-					1,
-					1,
-					1
-				);
+				std::size_t count = levelSlots[level];
+				levelSlots[level] = start;
+				start += count;
 			}
+		}
+
+		for (unsigned int i = 0; instances != NULL && i < posNum; i++)
+		{
+			glm::vec3 previous(particles.previousX[i], particles.previousY[i], particles.previousZ[i]);
+			glm::vec3 current(particles.x[i], particles.y[i], particles.z[i]);
+			glm::vec3 position = glm::mix(previous, current, blend);
+
+			std::size_t slot = sphereStyle == SPHERE_MESH ? levelSlots[sphereLevels[i]]++ : i;
+			ParticleInstance& instance = instances[slot];
+			instance.x = position.x;
+			instance.y = position.y;
+			instance.z = position.z;
 
-			float angle = 20.0f * j;
-			model = glm::rotate(model, (float)time * glm::radians(angle), glm::vec3(2.0f, 0.3f, 0.5f));
-			ourShader.setMat4("model", model);
+			// The sun (index 0) is bigger and white, particles are tinted by their velocity
 			if (i == 0)
 			{
-				sun.draw();
+				instance.scale = sunRadius;
+				instance.r = instance.g = instance.b = 1.0f;
 			}
 			else
 			{
-				particle.draw();
-				
+				instance.scale = particleRadius;
+				instance.r = particles.vx[i];
+				instance.g = particles.vy[i];
+				instance.b = particles.vz[i];
 			}
-			
 		}
+		renderer.draw(sphereStyle);
 
 		// Swaps the back and front buffer of the window and checks events
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
-	glBindVertexArray(0);
-	glDeleteVertexArrays(1, &VAO);
+	physics.stop();
+	simulationThread = NULL;
+
 	glDeleteShader(ourShader.ID);
-	delete[] startPositions;
-	delete[] newPosition;
-	delete[] initialVelocity;
+	glDeleteShader(impostorShader.ID);
 
 	glfwTerminate();
 	return 0;
@@ -281,7 +291,8 @@ void processInput(GLFWwindow* window)
 	// -- WINDOW --
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 	{
-		exit(EXIT_FAILURE);
+		// Leaves the main loop so the simulation thread is stopped before the program ends
+		glfwSetWindowShouldClose(window, true);
 	}
 
 	// -- MOVEMENT --
@@ -343,29 +354,40 @@ void processInput(GLFWwindow* window)
 	// Play and Pause
 	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
 	{
-		playingSpeed = 0.250f;
+		setPlayingSpeed(0.250f);
 	}
 	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
 	{
-		playingSpeed = 0.0f;
+		setPlayingSpeed(0.0f);
+	}
+
+	// -- RENDERING --
+	// Switches between impostors and meshes once per press
+	bool styleKey = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+	if (styleKey && !styleKeyHeld)
+	{
+		sphereStyle = sphereStyle == SPHERE_IMPOSTOR ? SPHERE_MESH : SPHERE_IMPOSTOR;
 	}
+	styleKeyHeld = styleKey;
 
 }
 
 void scroll_callback(GLFWwindow* window, double xOffSet, double yOffSet)
 {
 	float scrollSpeed = 0.05f; // Scrolling Sensitivity
-	playingSpeed += static_cast<float>(yOffSet) * scrollSpeed;
+	float speed = playingSpeed + static_cast<float>(yOffSet) * scrollSpeed;
 	
 	if (yOffSet < 0) 
 	{
-		if (playingSpeed <= 0) { playingSpeed = 0;} else {playingSpeed += static_cast<float>(yOffSet) * scrollSpeed;}
+		if (speed <= 0) { speed = 0;} else {speed += static_cast<float>(yOffSet) * scrollSpeed;}
 	}
 	else
 	{
-		if (playingSpeed >= 2.0f) { playingSpeed = 2.0f;} else {playingSpeed += static_cast<float>(yOffSet) * scrollSpeed;}
+		if (speed >= 2.0f) { speed = 2.0f;} else {speed += static_cast<float>(yOffSet) * scrollSpeed;}
 	}
 
+	setPlayingSpeed(speed);
+
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -396,33 +418,3 @@ void mouse_callback(GLFWwindow* window, double xPosIn, double yPosIn)
 	camera.ProcessMouseMovement(xOffset, yOffset);
 
 }
-
-void gravity(glm::vec3 &position, float strength, glm::vec3 &speed, glm::vec3 gravityPos, float playSpeed)
-{
-	float distanceX = position.x - gravityPos.x;
-	float distanceY = position.y - gravityPos.y;
-	float distanceZ = position.z - gravityPos.z;
-
-	float distance = glm::length(position - gravityPos);
-
-	float inverse_distance = 1.0f / distance;
-
-	float normalized_x = inverse_distance * distanceX;
-	float normalized_y = inverse_distance * distanceY;
-	float normalized_z = inverse_distance * distanceZ;
-
-	float inverse_square_dropoff = inverse_distance * inverse_distance;
-
-	glm::vec3 acceleration = glm::vec3(normalized_x * strength * inverse_square_dropoff,
-									   normalized_y * strength * inverse_square_dropoff,
-									   normalized_z * strength * inverse_square_dropoff);
-
-	speed.x += acceleration.x * playSpeed;
-	speed.y += acceleration.y * playSpeed;
-	speed.z += acceleration.z * playSpeed;
-
-	position.x += speed.x * playSpeed;
-	position.y += speed.y * playSpeed;
-	position.z += speed.z * playSpeed;
-
-}
\ No newline at end of file
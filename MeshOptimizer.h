@@ -0,0 +1,188 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Mesh-processing steps run once on generated meshes before they are uploaded, so the GPU transforms each vertex as
+// few times as possible and fetches as few bytes as possible. Indices are 32-bit here and narrowed on upload.
+
+// Post-transform cache size the triangle order is tuned for, a conservative fit for current GPUs
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// Float in [-1, 1] to a signed normalized 16-bit integer, read back by GL as value / 32767
+inline std::int16_t quantizeSnorm16(float value)
+{
+	float clamped = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+	return (std::int16_t)std::lround(clamped * 32767.0f);
+}
+
+// Merges vertices with identical bits (the seam and pole duplicates of a UV sphere once quantized), remaps indices to
+// the survivors and drops triangles that became degenerate. Returns the new vertex count.
+template <typename Vertex, typename Key>
+std::size_t weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, Key key)
+{
+	std::map<decltype(key(vertices[0])), unsigned int> unique;
+	std::vector<unsigned int> remap(vertices.size());
+	std::vector<Vertex> welded;
+	welded.reserve(vertices.size());
+
+	for (std::size_t v = 0; v < vertices.size(); v++)
+	{
+		auto inserted = unique.insert(std::make_pair(key(vertices[v]), (unsigned int)welded.size()));
+		if (inserted.second)
+		{
+			welded.push_back(vertices[v]);
+		}
+		remap[v] = inserted.first->second;
+	}
+
+	std::size_t kept = 0;
+	for (std::size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		unsigned int a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+		if (a != b && b != c && c != a)
+		{
+			indices[kept++] = a;
+			indices[kept++] = b;
+			indices[kept++] = c;
+		}
+	}
+	indices.resize(kept);
+	vertices.swap(welded);
+	return vertices.size();
+}
+
+// Reorders triangles for the post-transform vertex cache with Tipsify (Sander, Nehab and Barczak 2007). It fans around
+// one vertex at a time, emitting all of its remaining triangles, then moves on to a neighbour that will still be in the
+// cache once its own triangles are emitted, falling back to recently used vertices at dead ends. Linear time, and close
+// to Forsyth's algorithm in cache misses for regular meshes like these.
+inline void optimizeVertexCache(std::vector<unsigned int>& indices, std::size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+	std::size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles around each vertex, as offsets into one shared list
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (unsigned int index : indices)
+	{
+		liveTriangles[index]++;
+	}
+	std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+	for (std::size_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+	}
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (std::size_t i = 0; i < indices.size(); i++)
+	{
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	// Time each vertex last entered the cache; a vertex is cached while time - cacheTime[v] <= cacheSize
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+
+	unsigned int time = cacheSize + 1;
+	std::size_t cursor = 0;
+	long fanning = 0;
+
+	while (fanning >= 0)
+	{
+		std::vector<unsigned int> candidates;
+
+		for (unsigned int a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+			{
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[3 * t + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		// Next fan: of the candidates that would still be in the cache after emitting their own triangles, the one
+		// that entered it earliest
+		long next = -1;
+		unsigned int best = 0;
+		for (unsigned int v : candidates)
+		{
+			if (liveTriangles[v] > 0 && time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize && time - cacheTime[v] > best)
+			{
+				best = time - cacheTime[v];
+				next = v;
+			}
+		}
+
+		if (next < 0)
+		{
+			// Dead end: the most recently used vertex with triangles left, else the next one in index order
+			while (!deadEnd.empty() && next < 0)
+			{
+				unsigned int v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[v] > 0)
+				{
+					next = v;
+				}
+			}
+			while (next < 0 && cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+				{
+					next = (long)cursor;
+				}
+				cursor++;
+			}
+		}
+		fanning = next;
+	}
+
+	indices.swap(output);
+}
+
+// Renumbers vertices in the order the index buffer first uses them, so vertex fetches walk memory forwards, and drops
+// vertices no triangle uses
+template <typename Vertex>
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	std::vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (unsigned int)ordered.size();
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered);
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef PARTICLE_RENDERER_H
+#define PARTICLE_RENDERER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Sphere.h"
+#include "StreamBuffer.h"
+
+// Per-particle data the vertex shader reads once per instance (locations 3 to 5 in default.vert)
+struct ParticleInstance
+{
+	float x, y, z;
+	// Radius the unit sphere mesh is scaled to
+	float scale;
+	// Tint handed to the fragment shader, the old ampColor uniform
+	float r, g, b;
+};
+
+// How each particle is turned into pixels
+enum SphereStyle
+{
+	// The tessellated Sphere mesh, drawn with default.vert / default.frag at the level of detail given per bucket
+	SPHERE_MESH,
+	// A camera-facing quad the fragment shader ray-casts the sphere in, with impostor.vert / impostor.frag. 4 vertices
+	// instead of a mesh, and the depth written is the sphere's so the picture is the same.
+	SPHERE_IMPOSTOR
+};
+
+// Draws every particle with one instanced draw call. The per-particle position, scale and colour come from an
+// instance buffer refilled each frame, so the cost per particle is 28 bytes of upload instead of a matrix, a colour
+// uniform and a draw call. The instance buffer is a StreamBuffer: map() hands out the frame's region of it and the
+// caller writes the instances straight into it. Meshes are drawn with one instanced call per level of detail: the caller
+// writes the instances grouped by level, coarsest first, and tells the renderer how many went into each.
+class ParticleRenderer
+{
+	public:
+		// mesh must outlive the renderer
+		explicit ParticleRenderer(const Sphere& mesh) : mesh(mesh), instanceBuffer(GL_ARRAY_BUFFER), mappedCount(0)
+		{
+			glGenVertexArrays(1, &vao);
+			glBindVertexArray(vao);
+
+			mesh.bindPositions();
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+
+			// Pointed at the instance buffer in draw(), where the frame's region is known
+			for (GLuint location = 3; location <= 5; location++)
+			{
+				glEnableVertexAttribArray(location);
+				glVertexAttribDivisor(location, 1);
+			}
+
+			// The element buffer binding is part of the VAO, so only the array buffer is unbound
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+
+		~ParticleRenderer()
+		{
+			glDeleteVertexArrays(1, &vao);
+		}
+
+		// Returns room for count instances in GPU-visible memory, to be filled before draw(). NULL if the driver failed
+		// to map the buffer, draw() then draws nothing.
+		ParticleInstance* map(std::size_t count)
+		{
+			mappedCount = count;
+			// Until setLevelCounts says otherwise everything is drawn at the finest level
+			for (int level = 0; level < Sphere::lod_count; level++)
+			{
+				levelCounts[level] = level == Sphere::lod_count - 1 ? count : 0;
+			}
+			if (count == 0)
+			{
+				return NULL;
+			}
+
+			ParticleInstance* instances = (ParticleInstance*)instanceBuffer.begin((GLsizeiptr)(count * sizeof(ParticleInstance)));
+			if (instances == NULL)
+			{
+				mappedCount = 0;
+			}
+			return instances;
+		}
+
+		// Number of instances of each level of detail, in the order they were written. Only used for SPHERE_MESH.
+		void setLevelCounts(const std::size_t counts[Sphere::lod_count])
+		{
+			for (int level = 0; level < Sphere::lod_count; level++)
+			{
+				levelCounts[level] = counts[level];
+			}
+		}
+
+		// Draws the instances written since map(), the shader matching style must already be in use
+		void draw(SphereStyle style)
+		{
+			if (mappedCount == 0)
+			{
+				return;
+			}
+
+			instanceBuffer.commit();
+
+			glBindVertexArray(vao);
+			if (style == SPHERE_IMPOSTOR)
+			{
+				// The quad corners come from gl_VertexID, the mesh attribute is simply not read
+				pointInstances(0);
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)mappedCount);
+			}
+			else
+			{
+				// The instance attributes start at each bucket in turn (glDrawElementsInstancedBaseInstance is GL 4.2)
+				std::size_t first = 0;
+				for (int level = 0; level < Sphere::lod_count; level++)
+				{
+					if (levelCounts[level] > 0)
+					{
+						const SphereLod& lod = mesh.lods[level];
+						pointInstances(first);
+						glDrawElementsInstanced(GL_TRIANGLES, lod.indexCount, mesh.indexType, (void*)lod.indexOffset, (GLsizei)levelCounts[level]);
+						first += levelCounts[level];
+					}
+				}
+			}
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			instanceBuffer.fence();
+			mappedCount = 0;
+		}
+
+	private:
+		const Sphere& mesh;
+		GLuint vao;
+		StreamBuffer instanceBuffer;
+		std::size_t mappedCount;
+		std::size_t levelCounts[Sphere::lod_count];
+
+		// Points the per-instance attributes of the bound VAO at instance first of the current region
+		void pointInstances(std::size_t first)
+		{
+			const char* base = (const char*)(instanceBuffer.offset() + first * sizeof(ParticleInstance));
+			glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.id());
+			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), base + offsetof(ParticleInstance, x));
+			glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), base + offsetof(ParticleInstance, scale));
+			glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), base + offsetof(ParticleInstance, r));
+		}
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef ALIGNED_ALLOCATOR_H
+#define ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Cache line / AVX-512 register width, every particle array starts on one of these
+const std::size_t SIMD_ALIGNMENT = 64;
+
+// Minimal allocator so std::vector hands out memory aligned for SIMD loads
+template <typename T>
+class AlignedAllocator
+{
+public:
+	typedef T value_type;
+
+	AlignedAllocator() {}
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U>&) {}
+
+	T* allocate(std::size_t n)
+	{
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(SIMD_ALIGNMENT)));
+	}
+
+	void deallocate(T* p, std::size_t)
+	{
+		::operator delete(p, std::align_val_t(SIMD_ALIGNMENT));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U>&) const { return true; }
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+#endif
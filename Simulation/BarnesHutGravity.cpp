@@ -0,0 +1,246 @@
+#include "BarnesHutGravity.h"
+
+#include <cmath>
+#include <limits>
+
+#include "Parallel.h"
+
+// Tree walks are cheap to start but uneven in length, small chunks keep the threads balanced
+static const std::size_t WALK_GRAIN = 256;
+
+void BarnesHutGravity::computeAccelerations(ParticleStore& particles)
+{
+	particles.clearAccelerations();
+	if (particles.empty())
+	{
+		return;
+	}
+
+	octree.build(particles, leafSize);
+	computeMoments(particles);
+
+	// Walks in tree order so neighbouring walks touch the same nodes
+	parallelFor(0, particles.size(), WALK_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t k = begin; k < end; k++)
+		{
+			walk(particles, octree.order[k]);
+		}
+	});
+}
+
+void BarnesHutGravity::computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active)
+{
+	if (particles.empty())
+	{
+		return;
+	}
+
+	// The tree still holds every particle as a source, only the walks are limited to the active ones
+	octree.build(particles, leafSize);
+	computeMoments(particles);
+
+	parallelFor(0, active.size(), WALK_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t k = begin; k < end; k++)
+		{
+			walk(particles, active[k]);
+		}
+	});
+}
+
+void BarnesHutGravity::computeMoments(const ParticleStore& particles)
+{
+	const std::vector<OctreeNode>& nodes = octree.nodes;
+	moments.resize(nodes.size());
+
+	// Children always come after their parent, so a reverse sweep is bottom-up
+	for (std::size_t n = nodes.size(); n-- > 0;)
+	{
+		const OctreeNode& node = nodes[n];
+		Moments& m = moments[n];
+		double mass = 0.0, sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+
+		if (Octree::isLeaf(node))
+		{
+			for (std::uint32_t k = node.begin; k < node.begin + node.count; k++)
+			{
+				std::uint32_t i = octree.order[k];
+				mass += particles.mass[i];
+				sumX += (double)particles.mass[i] * particles.x[i];
+				sumY += (double)particles.mass[i] * particles.y[i];
+				sumZ += (double)particles.mass[i] * particles.z[i];
+			}
+		}
+		else
+		{
+			for (std::uint32_t c = 0; c < node.childCount; c++)
+			{
+				const Moments& child = moments[node.firstChild + c];
+				mass += child.mass;
+				sumX += (double)child.mass * child.x;
+				sumY += (double)child.mass * child.y;
+				sumZ += (double)child.mass * child.z;
+			}
+		}
+
+		m.mass = (float)mass;
+		if (mass > 0.0)
+		{
+			m.x = (float)(sumX / mass);
+			m.y = (float)(sumY / mass);
+			m.z = (float)(sumZ / mass);
+		}
+		else
+		{
+			m.x = node.centerX;
+			m.y = node.centerY;
+			m.z = node.centerZ;
+		}
+
+		for (int c = 0; c < 6; c++)
+		{
+			m.q[c] = 0.0f;
+		}
+
+		if (quadrupole && mass > 0.0)
+		{
+			// Leaves sum their particles, internal nodes shift their children's quadrupoles to the new center (parallel axis theorem)
+			auto addPoint = [&m](float pm, float dx, float dy, float dz)
+			{
+				float r2 = dx * dx + dy * dy + dz * dz;
+				m.q[0] += pm * (3.0f * dx * dx - r2);
+				m.q[1] += pm * (3.0f * dy * dy - r2);
+				m.q[2] += pm * (3.0f * dz * dz - r2);
+				m.q[3] += pm * 3.0f * dx * dy;
+				m.q[4] += pm * 3.0f * dx * dz;
+				m.q[5] += pm * 3.0f * dy * dz;
+			};
+
+			if (Octree::isLeaf(node))
+			{
+				for (std::uint32_t k = node.begin; k < node.begin + node.count; k++)
+				{
+					std::uint32_t i = octree.order[k];
+					addPoint(particles.mass[i], particles.x[i] - m.x, particles.y[i] - m.y, particles.z[i] - m.z);
+				}
+			}
+			else
+			{
+				for (std::uint32_t c = 0; c < node.childCount; c++)
+				{
+					const Moments& child = moments[node.firstChild + c];
+					for (int q = 0; q < 6; q++)
+					{
+						m.q[q] += child.q[q];
+					}
+					addPoint(child.mass, child.x - m.x, child.y - m.y, child.z - m.z);
+				}
+			}
+		}
+
+		if (theta > 0.0f)
+		{
+			float dx = m.x - node.centerX;
+			float dy = m.y - node.centerY;
+			float dz = m.z - node.centerZ;
+			float openRadius = 2.0f * node.halfSize / theta + std::sqrt(dx * dx + dy * dy + dz * dz);
+			m.openRadius2 = openRadius * openRadius;
+		}
+		else
+		{
+			m.openRadius2 = std::numeric_limits<float>::infinity();
+		}
+	}
+}
+
+void BarnesHutGravity::walk(ParticleStore& particles, std::uint32_t i) const
+{
+	const float* x = particles.x.data();
+	const float* y = particles.y.data();
+	const float* z = particles.z.data();
+	const float* mass = particles.mass.data();
+	// The spline kernel is Newtonian outside its radius, which is where the quadrupole correction matters
+	const float eps2 = softeningKernel == SOFTENING_SPLINE ? 0.0f : softening * softening;
+	const float xi = x[i], yi = y[i], zi = z[i];
+
+	float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+
+	// Each opened node pushes at most 8 children, per level of depth
+	std::uint32_t stack[8 * 40];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		std::uint32_t n = stack[--top];
+		const Moments& m = moments[n];
+		if (m.mass == 0.0f)
+		{
+			continue;
+		}
+
+		float dx = m.x - xi;
+		float dy = m.y - yi;
+		float dz = m.z - zi;
+		float r2 = dx * dx + dy * dy + dz * dz;
+
+		if (r2 > m.openRadius2)
+		{
+			// Far enough away to use the node as a whole
+			float invR3 = softenedForceFactor(r2, softening, softeningKernel);
+			float s = m.mass * invR3;
+			accX += dx * s;
+			accY += dy * s;
+			accZ += dz * s;
+
+			if (quadrupole)
+			{
+				// Separation from the node to the particle is -d, a = Q r / r^5 - 5/2 (r.Q.r) r / r^7
+				float rx = -dx, ry = -dy, rz = -dz;
+				float qx = m.q[0] * rx + m.q[3] * ry + m.q[4] * rz;
+				float qy = m.q[3] * rx + m.q[1] * ry + m.q[5] * rz;
+				float qz = m.q[4] * rx + m.q[5] * ry + m.q[2] * rz;
+				float rQr = rx * qx + ry * qy + rz * qz;
+				float invR2 = 1.0f / (r2 + eps2);
+				float invR5 = invR3 * invR2;
+				float invR7 = invR5 * invR2;
+				accX += qx * invR5 - 2.5f * rQr * rx * invR7;
+				accY += qy * invR5 - 2.5f * rQr * ry * invR7;
+				accZ += qz * invR5 - 2.5f * rQr * rz * invR7;
+			}
+			continue;
+		}
+
+		const OctreeNode& node = octree.nodes[n];
+		if (Octree::isLeaf(node))
+		{
+			for (std::uint32_t k = node.begin; k < node.begin + node.count; k++)
+			{
+				std::uint32_t j = octree.order[k];
+				float ex = x[j] - xi;
+				float ey = y[j] - yi;
+				float ez = z[j] - zi;
+				if (j == i)
+				{
+					continue;
+				}
+				float s = mass[j] * softenedForceFactor(ex * ex + ey * ey + ez * ez, softening, softeningKernel);
+				accX += ex * s;
+				accY += ey * s;
+				accZ += ez * s;
+			}
+		}
+		else
+		{
+			for (std::uint32_t c = 0; c < node.childCount; c++)
+			{
+				stack[top++] = node.firstChild + c;
+			}
+		}
+	}
+
+	particles.ax[i] = GRAVITATIONAL_CONSTANT * accX;
+	particles.ay[i] = GRAVITATIONAL_CONSTANT * accY;
+	particles.az[i] = GRAVITATIONAL_CONSTANT * accZ;
+}
@@ -0,0 +1,51 @@
+#ifndef BARNES_HUT_GRAVITY_H
+#define BARNES_HUT_GRAVITY_H
+
+#include <vector>
+
+#include "ForceSolver.h"
+#include "Octree.h"
+#include "Softening.h"
+
+// O(N log N) mutual gravity. Particles are grouped in an octree and distant groups are replaced by their
+// monopole (and optionally quadrupole) moments. theta is the opening angle: a node of size l whose center of mass
+// is further than l / theta + (offset of the center of mass from the node center) is used as a whole, 0 opens every node.
+class BarnesHutGravity : public ForceSolver
+{
+	public:
+		float theta;
+		bool quadrupole;
+		float softening;
+		// Plummer by default; with the spline kernel softening is the Plummer-equivalent length
+		SofteningKernel softeningKernel;
+		unsigned int leafSize;
+
+		explicit BarnesHutGravity(float theta = 0.5f, bool quadrupole = false, float softening = 0.0f, unsigned int leafSize = 16)
+			: theta(theta), quadrupole(quadrupole), softening(softening), softeningKernel(SOFTENING_PLUMMER), leafSize(leafSize) {}
+
+		void computeAccelerations(ParticleStore& particles) override;
+		void computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active) override;
+		const char* name() const override { return "barnes-hut"; }
+
+		const Octree& tree() const { return octree; }
+
+	private:
+		// Per-node multipole data, parallel to octree.nodes
+		struct Moments
+		{
+			float x, y, z;
+			float mass;
+			// Squared distance inside which the node must be opened
+			float openRadius2;
+			// Traceless quadrupole sum(m (3 d d - |d|^2 I)) about the center of mass: xx, yy, zz, xy, xz, yz
+			float q[6];
+		};
+
+		Octree octree;
+		std::vector<Moments> moments;
+
+		void computeMoments(const ParticleStore& particles);
+		void walk(ParticleStore& particles, std::uint32_t i) const;
+};
+
+#endif
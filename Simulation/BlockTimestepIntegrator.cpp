@@ -0,0 +1,209 @@
+#include "BlockTimestepIntegrator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Parallel.h"
+
+// Particles per chunk of the sub-step sweep (kick, drift and active scan) and of the closing kick over the active list
+static const std::size_t SWEEP_GRAIN = 16384;
+static const std::size_t ACTIVE_GRAIN = 1024;
+
+BlockTimestepIntegrator::BlockTimestepIntegrator(unsigned int maxLevel, float eta)
+	: maxLevel(std::min(maxLevel, MAX_LEVEL)), eta(eta), primed(false), primedLevel(0)
+{
+}
+
+std::vector<std::size_t> BlockTimestepIntegrator::binOccupancy() const
+{
+	return occupancy;
+}
+
+unsigned int BlockTimestepIntegrator::deepestBin() const
+{
+	for (unsigned int k = maxLevel; k > 0; k--)
+	{
+		if (occupancy[k] > 0)
+		{
+			return k;
+		}
+	}
+	return 0;
+}
+
+unsigned int BlockTimestepIntegrator::chooseBin(const ParticleStore& particles, std::uint32_t i, float dt, float stepLength) const
+{
+	float ax = particles.ax[i], ay = particles.ay[i], az = particles.az[i];
+	float acceleration = std::sqrt(ax * ax + ay * ay + az * az);
+	if (acceleration == 0.0f)
+	{
+		return 0;
+	}
+
+	float timescale;
+	if (hasHistory[i] && stepLength > 0.0f)
+	{
+		float jx = ax - lastAx[i], jy = ay - lastAy[i], jz = az - lastAz[i];
+		float jerk = std::sqrt(jx * jx + jy * jy + jz * jz) / stepLength;
+		timescale = jerk > 0.0f ? acceleration / jerk : std::numeric_limits<float>::infinity();
+	}
+	else
+	{
+		// |v| / |a| says nothing about a particle at rest (the sun of every disk), which would land in the deepest bin
+		// and make the whole step run at the smallest step length. Such particles start in bin 0 instead and the jerk
+		// measured over that first step moves them down.
+		float vx = particles.vx[i], vy = particles.vy[i], vz = particles.vz[i];
+		float speed = std::sqrt(vx * vx + vy * vy + vz * vz);
+		if (speed == 0.0f)
+		{
+			return 0;
+		}
+		timescale = speed / acceleration;
+	}
+
+	float wanted = eta * timescale;
+	if (!(wanted < dt))
+	{
+		return 0;
+	}
+	if (wanted <= 0.0f)
+	{
+		return maxLevel;
+	}
+
+	int level = (int)std::ceil(std::log2(dt / wanted));
+	return (unsigned int)std::max(0, std::min((int)maxLevel, level));
+}
+
+void BlockTimestepIntegrator::prime(ParticleStore& particles, ForceSolver& solver, float dt)
+{
+	std::size_t n = particles.size();
+
+	solver.computeAccelerations(particles);
+	forceEvaluations += n;
+
+	bins.assign(n, 0);
+	hasHistory.assign(n, 0);
+	lastAx.assign(particles.ax.begin(), particles.ax.begin() + n);
+	lastAy.assign(particles.ay.begin(), particles.ay.begin() + n);
+	lastAz.assign(particles.az.begin(), particles.az.begin() + n);
+	occupancy.assign(MAX_LEVEL + 1, 0);
+
+	for (std::uint32_t i = 0; i < n; i++)
+	{
+		bins[i] = (std::uint8_t)chooseBin(particles, i, dt, 0.0f);
+		occupancy[bins[i]]++;
+	}
+
+	primed = true;
+	primedLevel = maxLevel;
+}
+
+void BlockTimestepIntegrator::step(ParticleStore& particles, ForceSolver& solver, float dt)
+{
+	std::size_t n = particles.size();
+	if (n == 0)
+	{
+		return;
+	}
+
+	maxLevel = std::min(maxLevel, MAX_LEVEL);
+	if (!primed || bins.size() != n || primedLevel != maxLevel)
+	{
+		prime(particles, solver, dt);
+	}
+
+	// Time is counted in ticks of the deepest bin so bin boundaries are exact integers
+	const std::uint32_t ticks = 1u << maxLevel;
+	const float tickLength = dt / ticks;
+
+	std::uint32_t tick = 0;
+	while (tick < ticks)
+	{
+		// Next boundary of the deepest occupied bin, every other bin boundary is also one of these
+		std::uint32_t finest = ticks >> deepestBin();
+		std::uint32_t next = (tick / finest + 1) * finest;
+		float drift = (next - tick) * tickLength;
+
+		// Opening half kick for particles starting a step now, then drift everyone. Each chunk lists its own particles
+		// ending a step at the new tick and the lists are joined in chunk order, so the active list is in index order.
+		const std::uint32_t start = tick;
+		tick = next;
+		std::size_t chunks = (n + SWEEP_GRAIN - 1) / SWEEP_GRAIN;
+		activeChunks.resize(std::max(activeChunks.size(), chunks));
+		parallelFor(0, n, SWEEP_GRAIN, [&](std::size_t begin, std::size_t end)
+		{
+			// A chunk handed over whole may span several grains, each grain still gets its own list
+			for (std::size_t b = begin; b < end; b += SWEEP_GRAIN)
+			{
+				std::vector<std::uint32_t>& list = activeChunks[b / SWEEP_GRAIN];
+				list.clear();
+				for (std::size_t i = b, e = std::min(b + SWEEP_GRAIN, end); i < e; i++)
+				{
+					std::uint32_t length = ticks >> bins[i];
+					if (start % length == 0)
+					{
+						particles.kick(i, 0.5f * length * tickLength);
+					}
+
+					particles.drift(i, drift);
+
+					if (tick % length == 0)
+					{
+						list.push_back((std::uint32_t)i);
+					}
+				}
+			}
+		});
+
+		active.clear();
+		for (std::size_t c = 0; c < chunks; c++)
+		{
+			active.insert(active.end(), activeChunks[c].begin(), activeChunks[c].end());
+		}
+
+		solver.computeActiveAccelerations(particles, active);
+		forceEvaluations += active.size();
+
+		// Closing half kick, then pick the bin each particle's new acceleration asks for. Deeper bins are always allowed,
+		// shallower ones only one level at a time and only when this tick is also a boundary of that bin.
+		rebinned.resize(active.size());
+		parallelFor(0, active.size(), ACTIVE_GRAIN, [&](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t k = begin; k < end; k++)
+			{
+				std::uint32_t i = active[k];
+				unsigned int bin = bins[i];
+				float stepLength = (ticks >> bin) * tickLength;
+				particles.kick(i, 0.5f * stepLength);
+
+				unsigned int wanted = chooseBin(particles, i, dt, stepLength);
+				if (wanted < bin)
+				{
+					wanted = bin - 1;
+					if (tick % (ticks >> wanted) != 0)
+					{
+						wanted = bin;
+					}
+				}
+				rebinned[k] = (std::uint8_t)wanted;
+
+				// Not through pointers taken before the loop: the default computeActiveAccelerations swaps in new arrays
+				lastAx[i] = particles.ax[i];
+				lastAy[i] = particles.ay[i];
+				lastAz[i] = particles.az[i];
+				hasHistory[i] = 1;
+			}
+		});
+
+		// Bins are only moved after every chooseBin above has run, the occupancy counts are shared
+		for (std::size_t k = 0; k < active.size(); k++)
+		{
+			std::uint32_t i = active[k];
+			occupancy[bins[i]]--;
+			occupancy[rebinned[k]]++;
+			bins[i] = rebinned[k];
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef BLOCK_TIMESTEP_INTEGRATOR_H
+#define BLOCK_TIMESTEP_INTEGRATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Integrator.h"
+
+// Kick-drift-kick leapfrog with hierarchical power-of-two time bins. Particle i lives in bin k and takes steps of
+// dt / 2^k. Every sub-step drifts all particles but only the particles whose step ends there get a force evaluation,
+// so the few particles close to the sun set the smallest step without dragging the rest of the disk down with them.
+// Bins come from the acceleration timescale eta * |a| / |da/dt|, with da/dt estimated from consecutive evaluations
+// (eta * |v| / |a| before a particle has a history, bin 0 if it is also at rest). All particles are synchronised again at the end of each step.
+class BlockTimestepIntegrator : public Integrator
+{
+	public:
+		// Deepest bin, the smallest step is dt / 2^maxLevel
+		unsigned int maxLevel;
+		// Fraction of the acceleration timescale used as the step
+		float eta;
+
+		explicit BlockTimestepIntegrator(unsigned int maxLevel = 10, float eta = 0.05f);
+
+		void step(ParticleStore& particles, ForceSolver& solver, float dt) override;
+		void reset() override { primed = false; }
+		const char* name() const override { return "block"; }
+
+		// Particles per bin after the last step
+		std::vector<std::size_t> binOccupancy() const;
+
+	private:
+		static const unsigned int MAX_LEVEL = 30;
+
+		bool primed;
+		// maxLevel the bins were assigned with
+		unsigned int primedLevel;
+		std::vector<std::uint8_t> bins;
+		// Whether lastAx/y/z hold an earlier evaluation to estimate da/dt from
+		std::vector<std::uint8_t> hasHistory;
+		std::vector<float> lastAx, lastAy, lastAz;
+		std::vector<std::uint32_t> active;
+		// Per-chunk pieces of the active list and the new bin of each active particle, reused across sub-steps
+		std::vector<std::vector<std::uint32_t>> activeChunks;
+		std::vector<std::uint8_t> rebinned;
+		// Particles per bin, kept up to date so the deepest occupied bin is cheap to find
+		std::vector<std::size_t> occupancy;
+
+		void prime(ParticleStore& particles, ForceSolver& solver, float dt);
+		unsigned int chooseBin(const ParticleStore& particles, std::uint32_t i, float dt, float stepLength) const;
+		unsigned int deepestBin() const;
+};
+
+#endif
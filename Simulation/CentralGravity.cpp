@@ -0,0 +1,57 @@
+#include "CentralGravity.h"
+
+#include <cmath>
+
+// Pull of the sun on particle i, softened like the pairwise solvers so a particle passing through the sun stays finite
+static inline void sunAcceleration(ParticleStore& particles, std::size_t i, float strength, float softening, SofteningKernel kernel)
+{
+	float distanceX = particles.x[i] - particles.x[0];
+	float distanceY = particles.y[i] - particles.y[0];
+	float distanceZ = particles.z[i] - particles.z[0];
+
+	float r2 = distanceX * distanceX + distanceY * distanceY + distanceZ * distanceZ;
+	float inverse_cube_dropoff = strength * softenedForceFactor(r2, softening, kernel);
+
+	particles.ax[i] = distanceX * inverse_cube_dropoff;
+	particles.ay[i] = distanceY * inverse_cube_dropoff;
+	particles.az[i] = distanceZ * inverse_cube_dropoff;
+}
+
+void CentralGravity::computeAccelerations(ParticleStore& particles)
+{
+	std::size_t n = particles.size();
+	if (n == 0)
+	{
+		return;
+	}
+
+	const float strength = -GRAVITATIONAL_CONSTANT * particles.mass[0];
+
+	particles.ax[0] = particles.ay[0] = particles.az[0] = 0.0f;
+	for (std::size_t i = 1; i < n; i++)
+	{
+		sunAcceleration(particles, i, strength, softening, softeningKernel);
+	}
+}
+
+void CentralGravity::computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active)
+{
+	if (particles.empty())
+	{
+		return;
+	}
+
+	const float strength = -GRAVITATIONAL_CONSTANT * particles.mass[0];
+
+	for (std::uint32_t i : active)
+	{
+		if (i == 0)
+		{
+			particles.ax[0] = particles.ay[0] = particles.az[0] = 0.0f;
+		}
+		else
+		{
+			sunAcceleration(particles, i, strength, softening, softeningKernel);
+		}
+	}
+}
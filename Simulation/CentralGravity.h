@@ -0,0 +1,24 @@
+#ifndef CENTRAL_GRAVITY_H
+#define CENTRAL_GRAVITY_H
+
+#include "ForceSolver.h"
+#include "Softening.h"
+
+// The original sun-only model: every particle is pulled toward the particle at index 0 (the sun)
+// and particles never attract each other. The sun itself feels no force.
+class CentralGravity : public ForceSolver
+{
+	public:
+		float softening;
+		// Plummer by default; with the spline kernel softening is the Plummer-equivalent length
+		SofteningKernel softeningKernel;
+
+		explicit CentralGravity(float softening = 0.0f, SofteningKernel kernel = SOFTENING_PLUMMER)
+			: softening(softening), softeningKernel(kernel) {}
+
+		void computeAccelerations(ParticleStore& particles) override;
+		void computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active) override;
+		const char* name() const override { return "central"; }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "Diagnostics.h"
+
+#include <cmath>
+
+#include "ForceSolver.h"
+#include "Parallel.h"
+
+// Rows of the pair sum per chunk, the rows get shorter towards the end so chunks are kept small
+static const std::size_t PAIR_GRAIN = 64;
+static const std::size_t PARTICLE_GRAIN = 4096;
+
+// Kinetic energy, momentum and angular momentum
+struct ParticleSums
+{
+	double value[7];
+};
+
+static ParticleSums addSums(const ParticleSums& a, const ParticleSums& b)
+{
+	ParticleSums sum;
+	for (int k = 0; k < 7; k++)
+	{
+		sum.value[k] = a.value[k] + b.value[k];
+	}
+	return sum;
+}
+
+ConservedQuantities measureConserved(const ParticleStore& particles, float softening, SofteningKernel kernel, bool softenSun)
+{
+	std::size_t n = particles.size();
+	const double eps = softening;
+
+	ParticleSums zero = {};
+	ParticleSums sums = parallelReduce(0, n, PARTICLE_GRAIN, zero, [&](std::size_t begin, std::size_t end)
+	{
+		ParticleSums chunk = {};
+		for (std::size_t i = begin; i < end; i++)
+		{
+			double m = particles.mass[i];
+			double x = particles.x[i], y = particles.y[i], z = particles.z[i];
+			double vx = particles.vx[i], vy = particles.vy[i], vz = particles.vz[i];
+			chunk.value[0] += 0.5 * m * (vx * vx + vy * vy + vz * vz);
+			chunk.value[1] += m * vx;
+			chunk.value[2] += m * vy;
+			chunk.value[3] += m * vz;
+			chunk.value[4] += m * (y * vz - z * vy);
+			chunk.value[5] += m * (z * vx - x * vz);
+			chunk.value[6] += m * (x * vy - y * vx);
+		}
+		return chunk;
+	}, addSums);
+
+	// Each pair once, row i holds the pairs (i, j > i)
+	double potential = parallelReduce(0, n, PAIR_GRAIN, 0.0, [&](std::size_t begin, std::size_t end)
+	{
+		double chunk = 0.0;
+		for (std::size_t i = begin; i < end; i++)
+		{
+			double mi = particles.mass[i];
+			if (mi == 0.0)
+			{
+				continue;
+			}
+			double row = 0.0;
+			const double rowEps = i == 0 && !softenSun ? 0.0 : eps;
+			for (std::size_t j = i + 1; j < n; j++)
+			{
+				double dx = (double)particles.x[j] - particles.x[i];
+				double dy = (double)particles.y[j] - particles.y[i];
+				double dz = (double)particles.z[j] - particles.z[i];
+				row += particles.mass[j] * softenedInverseDistance(dx * dx + dy * dy + dz * dz, rowEps, kernel);
+			}
+			chunk -= GRAVITATIONAL_CONSTANT * mi * row;
+		}
+		return chunk;
+	}, [](double a, double b) { return a + b; });
+
+	ConservedQuantities result;
+	result.kinetic = sums.value[0];
+	result.potential = potential;
+	for (int k = 0; k < 3; k++)
+	{
+		result.momentum[k] = sums.value[1 + k];
+		result.angularMomentum[k] = sums.value[4 + k];
+	}
+	return result;
+}
@@ -0,0 +1,25 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "ParticleStore.h"
+#include "Softening.h"
+
+// Quantities a closed system conserves, for checking integrators and comparing runs
+struct ConservedQuantities
+{
+	double kinetic;
+	double potential;
+	double momentum[3];
+	double angularMomentum[3];
+
+	double energy() const { return kinetic + potential; }
+};
+
+// Sums every particle and pair (the potential is O(N^2), with the same softening and kernel the solver used) in double.
+// softenSun = false leaves the pairs with the sun (particle 0) unsoftened, for integrators that take the sun's pull
+// exactly and only soften the mutual forces. Every sum goes through parallelReduce, so the result is bit-identical for
+// any thread count.
+ConservedQuantities measureConserved(const ParticleStore& particles, float softening = 0.0f, SofteningKernel kernel = SOFTENING_PLUMMER,
+	bool softenSun = true);
+
+#endif
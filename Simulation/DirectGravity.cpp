@@ -0,0 +1,82 @@
+#include "DirectGravity.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "GravityKernel.h"
+#include "Parallel.h"
+
+const char* DirectGravity::kernelName()
+{
+	return gravityKernelName();
+}
+
+void DirectGravity::computeAccelerations(ParticleStore& particles)
+{
+	particles.clearAccelerations();
+
+	std::size_t n = particles.size();
+	std::size_t padded = particles.paddedSize();
+
+	// Blocks of i-particles spread over the threads, each sweeping every j tile so the tile is reused from L1 for a whole block
+	parallelFor(0, n, TILE_SIZE, [&](std::size_t iBegin, std::size_t iEnd)
+	{
+		for (std::size_t jBegin = 0; jBegin < padded; jBegin += TILE_SIZE)
+		{
+			accumulate(particles, iBegin, iEnd, jBegin, std::min(jBegin + TILE_SIZE, padded));
+		}
+	});
+}
+
+void DirectGravity::computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active)
+{
+	std::size_t padded = particles.paddedSize();
+
+	// Same tiling as the full evaluation, with blocks of active particles instead of contiguous ranges
+	parallelFor(0, active.size(), TILE_SIZE, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t k = begin; k < end; k++)
+		{
+			std::uint32_t i = active[k];
+			particles.ax[i] = particles.ay[i] = particles.az[i] = 0.0f;
+		}
+
+		for (std::size_t jBegin = 0; jBegin < padded; jBegin += TILE_SIZE)
+		{
+			std::size_t jEnd = std::min(jBegin + TILE_SIZE, padded);
+			const float* x = particles.x.data() + jBegin;
+			const float* y = particles.y.data() + jBegin;
+			const float* z = particles.z.data() + jBegin;
+			const float* m = particles.mass.data() + jBegin;
+
+			for (std::size_t k = begin; k < end; k++)
+			{
+				std::uint32_t i = active[k];
+				float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+				accumulateSoftenedGravity(x, y, z, m, jEnd - jBegin, particles.x[i], particles.y[i], particles.z[i], softening, kernel, accX, accY, accZ);
+
+				particles.ax[i] += GRAVITATIONAL_CONSTANT * accX;
+				particles.ay[i] += GRAVITATIONAL_CONSTANT * accY;
+				particles.az[i] += GRAVITATIONAL_CONSTANT * accZ;
+			}
+		}
+	});
+}
+
+void DirectGravity::accumulate(ParticleStore& particles, std::size_t iBegin, std::size_t iEnd, std::size_t jBegin, std::size_t jEnd) const
+{
+	const float* x = particles.x.data() + jBegin;
+	const float* y = particles.y.data() + jBegin;
+	const float* z = particles.z.data() + jBegin;
+	const float* m = particles.mass.data() + jBegin;
+
+	for (std::size_t i = iBegin; i < iEnd; i++)
+	{
+		float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+		accumulateSoftenedGravity(x, y, z, m, jEnd - jBegin, particles.x[i], particles.y[i], particles.z[i], softening, kernel, accX, accY, accZ);
+
+		particles.ax[i] += GRAVITATIONAL_CONSTANT * accX;
+		particles.ay[i] += GRAVITATIONAL_CONSTANT * accY;
+		particles.az[i] += GRAVITATIONAL_CONSTANT * accZ;
+	}
+}
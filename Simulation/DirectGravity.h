@@ -0,0 +1,37 @@
+#ifndef DIRECT_GRAVITY_H
+#define DIRECT_GRAVITY_H
+
+#include <cstddef>
+
+#include "ForceSolver.h"
+#include "Softening.h"
+
+// Mutual gravity by summing every pair directly. O(N^2) but exact, and the fastest option up to a few tens of thousands of particles.
+// The j-particles are walked in tiles that fit in L1 while each i-particle is accumulated 8 (AVX2) or 16 (AVX-512) j-lanes at a time
+// by the shared kernel in GravityKernel.h.
+class DirectGravity : public ForceSolver
+{
+	public:
+		// Number of j-particles per tile, 4 arrays * 4 bytes * 1024 = 16KB so a tile sits comfortably in L1
+		static const std::size_t TILE_SIZE = 1024;
+
+		// softening is the Plummer length added to every separation (or the Plummer-equivalent length of the spline kernel),
+		// 0 gives the exact Newtonian force
+		explicit DirectGravity(float softening = 0.0f, SofteningKernel kernel = SOFTENING_PLUMMER) : softening(softening), kernel(kernel) {}
+
+		void computeAccelerations(ParticleStore& particles) override;
+		void computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active) override;
+		const char* name() const override { return "direct"; }
+
+		// Accumulates the force from j-particles [jBegin, jEnd) onto i-particles [iBegin, iEnd). jEnd may run into the padding.
+		void accumulate(ParticleStore& particles, std::size_t iBegin, std::size_t iEnd, std::size_t jBegin, std::size_t jEnd) const;
+
+		// Which kernel this build uses ("avx512", "avx2" or "scalar")
+		static const char* kernelName();
+
+	private:
+		float softening;
+		SofteningKernel kernel;
+};
+
+#endif
@@ -0,0 +1,11 @@
+#include "EulerIntegrator.h"
+
+void EulerIntegrator::step(ParticleStore& particles, ForceSolver& solver, float dt)
+{
+	solver.computeAccelerations(particles);
+
+	forceEvaluations += particles.size();
+
+	particles.kick(dt);
+	particles.drift(dt);
+}
@@ -0,0 +1,14 @@
+#ifndef EULER_INTEGRATOR_H
+#define EULER_INTEGRATOR_H
+
+#include "Integrator.h"
+
+// Semi-implicit Euler (kick then drift) with one force evaluation per step, exactly like the old gravity()
+class EulerIntegrator : public Integrator
+{
+	public:
+		void step(ParticleStore& particles, ForceSolver& solver, float dt) override;
+		const char* name() const override { return "euler"; }
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "Fft.h"
+
+#include <cmath>
+
+#include "Parallel.h"
+
+void Fft3d::resize(std::size_t size)
+{
+	n = size;
+	twiddles.resize(n / 2);
+	bitReverse.resize(n);
+
+	for (std::size_t k = 0; k < n / 2; k++)
+	{
+		double angle = -2.0 * 3.14159265358979323846 * (double)k / (double)n;
+		twiddles[k] = Complex((float)std::cos(angle), (float)std::sin(angle));
+	}
+
+	int bits = 0;
+	while (((std::size_t)1 << bits) < n)
+	{
+		bits++;
+	}
+	for (std::size_t i = 0; i < n; i++)
+	{
+		std::size_t reversed = 0;
+		for (int b = 0; b < bits; b++)
+		{
+			reversed |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		bitReverse[i] = reversed;
+	}
+}
+
+void Fft3d::transformLine(Complex* line, bool inverse) const
+{
+	for (std::size_t i = 0; i < n; i++)
+	{
+		if (i < bitReverse[i])
+		{
+			std::swap(line[i], line[bitReverse[i]]);
+		}
+	}
+
+	// Iterative radix-2 butterflies
+	for (std::size_t length = 2; length <= n; length <<= 1)
+	{
+		std::size_t half = length / 2;
+		std::size_t step = n / length;
+		for (std::size_t start = 0; start < n; start += length)
+		{
+			for (std::size_t k = 0; k < half; k++)
+			{
+				Complex w = twiddles[k * step];
+				if (inverse)
+				{
+					w = std::conj(w);
+				}
+				Complex a = line[start + k];
+				Complex b = line[start + k + half];
+				Complex t(b.real() * w.real() - b.imag() * w.imag(), b.real() * w.imag() + b.imag() * w.real());
+				line[start + k] = a + t;
+				line[start + k + half] = a - t;
+			}
+		}
+	}
+}
+
+void Fft3d::transform(Complex* grid, bool inverse) const
+{
+	if (n < 2)
+	{
+		return;
+	}
+
+	const std::size_t n2 = n * n;
+
+	// z lines are contiguous
+	parallelFor(0, n2, 64, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t line = begin; line < end; line++)
+		{
+			transformLine(grid + line * n, inverse);
+		}
+	});
+
+	// y and x lines are strided, gather them into a contiguous buffer first
+	for (int axis = 0; axis < 2; axis++)
+	{
+		std::size_t stride = axis == 0 ? n : n2;
+
+		parallelFor(0, n2, 64, [&](std::size_t begin, std::size_t end)
+		{
+			std::vector<Complex> buffer(n);
+			for (std::size_t line = begin; line < end; line++)
+			{
+				// line enumerates the two axes that are not being transformed
+				std::size_t outer = line / n;
+				std::size_t inner = line % n;
+				std::size_t base = axis == 0 ? outer * n2 + inner : outer * n + inner;
+
+				for (std::size_t i = 0; i < n; i++)
+				{
+					buffer[i] = grid[base + i * stride];
+				}
+				transformLine(buffer.data(), inverse);
+				for (std::size_t i = 0; i < n; i++)
+				{
+					grid[base + i * stride] = buffer[i];
+				}
+			}
+		});
+	}
+}
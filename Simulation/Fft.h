@@ -0,0 +1,33 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// In-place 3D FFT of an n x n x n cube (n a power of two) stored x-major: index (x * n + y) * n + z.
+// Every pass transforms independent lines, which are spread over the worker threads.
+class Fft3d
+{
+	public:
+		typedef std::complex<float> Complex;
+
+		explicit Fft3d(std::size_t n = 0) { resize(n); }
+
+		void resize(std::size_t n);
+		std::size_t size() const { return n; }
+
+		// Forward transform uses exp(-i k x), the inverse is unnormalised (divide by n^3 afterwards)
+		void forward(Complex* grid) const { transform(grid, false); }
+		void inverse(Complex* grid) const { transform(grid, true); }
+
+	private:
+		std::size_t n;
+		std::vector<Complex> twiddles;
+		std::vector<std::size_t> bitReverse;
+
+		void transform(Complex* grid, bool inverse) const;
+		void transformLine(Complex* line, bool inverse) const;
+};
+
+#endif
@@ -0,0 +1,524 @@
+#include "FmmGravity.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "GravityKernel.h"
+#include "Parallel.h"
+
+static const double PI = 3.14159265358979323846;
+
+// (-1)^n
+static inline double oddEven(int n)
+{
+	return (n & 1) ? -1.0 : 1.0;
+}
+
+// 1 for m >= 0, (-1)^m otherwise
+static inline double ipow2n(int m)
+{
+	return m >= 0 ? 1.0 : oddEven(m);
+}
+
+// Plain complex product, std::complex's operator* guards against inf/nan and is several times slower in the M2L loops
+static inline std::complex<double> multiply(const std::complex<double>& a, const std::complex<double>& b)
+{
+	return std::complex<double>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+// Spherical coordinates of (dx, dy, dz). Directions exactly on the z axis are nudged off it because
+// the angular derivatives divide by sin(theta).
+static inline void cartesianToSpherical(double dx, double dy, double dz, double& r, double& theta, double& phi)
+{
+	const double axisGuard = 1e-9;
+	r = std::sqrt(dx * dx + dy * dy + dz * dz);
+	theta = r == 0.0 ? 0.0 : std::acos(std::max(-1.0, std::min(1.0, dz / r)));
+	theta = std::max(axisGuard, std::min(PI - axisGuard, theta));
+	phi = std::atan2(dy, dx);
+}
+
+void FmmGravity::computeAccelerations(ParticleStore& particles)
+{
+	particles.clearAccelerations();
+	if (particles.empty())
+	{
+		return;
+	}
+
+	terms = static_cast<int>(order) + 1;
+	coefficients = terms * (terms + 1) / 2;
+
+	octree.build(particles, leafSize);
+
+	std::size_t n = particles.size();
+	AlignedVector<float>* sorted[] = { &sortedX, &sortedY, &sortedZ, &sortedMass, &sortedAx, &sortedAy, &sortedAz };
+	for (AlignedVector<float>* a : sorted)
+	{
+		a->assign(n, 0.0f);
+	}
+	for (std::size_t k = 0; k < n; k++)
+	{
+		std::uint32_t i = octree.order[k];
+		sortedX[k] = particles.x[i];
+		sortedY[k] = particles.y[i];
+		sortedZ[k] = particles.z[i];
+		sortedMass[k] = particles.mass[i];
+	}
+
+	upwardPass();
+	traverse();
+	downwardPass();
+
+	for (std::size_t k = 0; k < n; k++)
+	{
+		std::uint32_t i = octree.order[k];
+		particles.ax[i] = GRAVITATIONAL_CONSTANT * sortedAx[k];
+		particles.ay[i] = GRAVITATIONAL_CONSTANT * sortedAy[k];
+		particles.az[i] = GRAVITATIONAL_CONSTANT * sortedAz[k];
+	}
+}
+
+float FmmGravity::cellRadius(std::uint32_t cell) const
+{
+	// Expansions are centred on the cell centre, so every particle is within the half diagonal
+	return octree.nodes[cell].halfSize * 1.7320508f;
+}
+
+// --------------------- UPWARD PASS ---------------------
+
+void FmmGravity::upwardPass()
+{
+	const std::vector<OctreeNode>& nodes = octree.nodes;
+	multipoles.assign(nodes.size() * coefficients, Complex(0.0, 0.0));
+
+	parallelFor(0, nodes.size(), 64, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t c = begin; c < end; c++)
+		{
+			if (Octree::isLeaf(nodes[c]))
+			{
+				particleToMultipole(static_cast<std::uint32_t>(c));
+			}
+		}
+	});
+
+	// Children always come after their parent, so a reverse sweep is bottom-up
+	for (std::size_t c = nodes.size(); c-- > 0;)
+	{
+		if (!Octree::isLeaf(nodes[c]))
+		{
+			multipoleToMultipole(static_cast<std::uint32_t>(c));
+		}
+	}
+}
+
+void FmmGravity::particleToMultipole(std::uint32_t cell)
+{
+	const OctreeNode& node = octree.nodes[cell];
+	Complex* M = &multipoles[cell * coefficients];
+	std::vector<Complex> Ynm(terms * terms), YnmTheta(terms * terms);
+
+	for (std::uint32_t k = node.begin; k < node.begin + node.count; k++)
+	{
+		if (sortedMass[k] == 0.0f)
+		{
+			continue;
+		}
+
+		double rho, alpha, beta;
+		cartesianToSpherical(sortedX[k] - node.centerX, sortedY[k] - node.centerY, sortedZ[k] - node.centerZ, rho, alpha, beta);
+		evalMultipole(rho, alpha, -beta, Ynm.data(), YnmTheta.data());
+
+		for (int n = 0; n < terms; n++)
+		{
+			for (int m = 0; m <= n; m++)
+			{
+				M[n * (n + 1) / 2 + m] += (double)sortedMass[k] * Ynm[n * n + n + m];
+			}
+		}
+	}
+}
+
+void FmmGravity::multipoleToMultipole(std::uint32_t parent)
+{
+	const OctreeNode& node = octree.nodes[parent];
+	Complex* Mi = &multipoles[parent * coefficients];
+	std::vector<Complex> Ynm(terms * terms), YnmTheta(terms * terms);
+
+	for (std::uint32_t c = 0; c < node.childCount; c++)
+	{
+		std::uint32_t child = node.firstChild + c;
+		const OctreeNode& childNode = octree.nodes[child];
+		const Complex* Mj = &multipoles[child * coefficients];
+
+		double rho, alpha, beta;
+		cartesianToSpherical(node.centerX - childNode.centerX, node.centerY - childNode.centerY, node.centerZ - childNode.centerZ, rho, alpha, beta);
+		evalMultipole(rho, alpha, beta, Ynm.data(), YnmTheta.data());
+
+		for (int j = 0; j < terms; j++)
+		{
+			for (int k = 0; k <= j; k++)
+			{
+				Complex M(0.0, 0.0);
+				for (int n = 0; n <= j; n++)
+				{
+					for (int m = std::max(-n, -j + k + n); m <= std::min(k - 1, n); m++)
+					{
+						int jnkms = (j - n) * (j - n + 1) / 2 + k - m;
+						M += multiply(Mj[jnkms], Ynm[n * n + n - m]) * (ipow2n(m) * oddEven(n));
+					}
+					for (int m = k; m <= std::min(n, j + k - n); m++)
+					{
+						int jnkms = (j - n) * (j - n + 1) / 2 - k + m;
+						M += multiply(std::conj(Mj[jnkms]), Ynm[n * n + n - m]) * oddEven(k + n + m);
+					}
+				}
+				Mi[j * (j + 1) / 2 + k] += M;
+			}
+		}
+	}
+}
+
+// --------------------- DUAL TREE TRAVERSAL ---------------------
+
+void FmmGravity::traverse()
+{
+	std::vector<std::uint64_t> m2lPairs, p2pPairs;
+	interact(0, 0, m2lPairs, p2pPairs);
+
+	// Pairs are packed target << 32 | source, a stable sort groups them by target and keeps the traversal order
+	std::size_t cells = octree.nodes.size();
+	auto compress = [cells](std::vector<std::uint64_t>& pairs, std::vector<std::uint32_t>& start, std::vector<std::uint32_t>& sources)
+	{
+		std::stable_sort(pairs.begin(), pairs.end(), [](std::uint64_t a, std::uint64_t b) { return (a >> 32) < (b >> 32); });
+		start.assign(cells + 1, 0);
+		sources.resize(pairs.size());
+		for (std::size_t p = 0; p < pairs.size(); p++)
+		{
+			start[(pairs[p] >> 32) + 1]++;
+			sources[p] = static_cast<std::uint32_t>(pairs[p]);
+		}
+		for (std::size_t c = 0; c < cells; c++)
+		{
+			start[c + 1] += start[c];
+		}
+	};
+
+	compress(m2lPairs, m2lStart, m2lSources);
+	compress(p2pPairs, p2pStart, p2pSources);
+}
+
+void FmmGravity::interact(std::uint32_t target, std::uint32_t source, std::vector<std::uint64_t>& m2lPairs, std::vector<std::uint64_t>& p2pPairs) const
+{
+	const OctreeNode& ti = octree.nodes[target];
+	const OctreeNode& sj = octree.nodes[source];
+
+	float dx = ti.centerX - sj.centerX;
+	float dy = ti.centerY - sj.centerY;
+	float dz = ti.centerZ - sj.centerZ;
+	float radii = cellRadius(target) + cellRadius(source);
+
+	if (target != source && radii * radii < theta * theta * (dx * dx + dy * dy + dz * dz))
+	{
+		m2lPairs.push_back((std::uint64_t)target << 32 | source);
+	}
+	else if (Octree::isLeaf(ti) && Octree::isLeaf(sj))
+	{
+		p2pPairs.push_back((std::uint64_t)target << 32 | source);
+	}
+	else if (Octree::isLeaf(sj) || (!Octree::isLeaf(ti) && ti.halfSize >= sj.halfSize))
+	{
+		// Split the bigger cell
+		for (std::uint32_t c = 0; c < ti.childCount; c++)
+		{
+			interact(ti.firstChild + c, source, m2lPairs, p2pPairs);
+		}
+	}
+	else
+	{
+		for (std::uint32_t c = 0; c < sj.childCount; c++)
+		{
+			interact(target, sj.firstChild + c, m2lPairs, p2pPairs);
+		}
+	}
+}
+
+// --------------------- DOWNWARD PASS ---------------------
+
+void FmmGravity::downwardPass()
+{
+	const std::vector<OctreeNode>& nodes = octree.nodes;
+	locals.assign(nodes.size() * coefficients, Complex(0.0, 0.0));
+
+	// Every target cell only writes its own local expansion, so targets can run in parallel
+	parallelFor(0, nodes.size(), 16, [&](std::size_t begin, std::size_t end)
+	{
+		std::vector<Complex> Ynm(4 * terms * terms);
+		for (std::size_t c = begin; c < end; c++)
+		{
+			for (std::uint32_t s = m2lStart[c]; s < m2lStart[c + 1]; s++)
+			{
+				multipoleToLocal(static_cast<std::uint32_t>(c), m2lSources[s], Ynm);
+			}
+		}
+	});
+
+	// Parents come before their children, so a forward sweep is top-down
+	for (std::size_t c = 0; c < nodes.size(); c++)
+	{
+		if (!Octree::isLeaf(nodes[c]))
+		{
+			localToLocal(static_cast<std::uint32_t>(c));
+		}
+	}
+
+	parallelFor(0, nodes.size(), 16, [&](std::size_t begin, std::size_t end)
+	{
+		std::vector<Complex> Ynm(terms * terms), YnmTheta(terms * terms);
+		for (std::size_t c = begin; c < end; c++)
+		{
+			if (!Octree::isLeaf(nodes[c]))
+			{
+				continue;
+			}
+
+			localToParticle(static_cast<std::uint32_t>(c), Ynm, YnmTheta);
+			for (std::uint32_t s = p2pStart[c]; s < p2pStart[c + 1]; s++)
+			{
+				particleToParticle(static_cast<std::uint32_t>(c), p2pSources[s]);
+			}
+		}
+	});
+}
+
+void FmmGravity::multipoleToLocal(std::uint32_t target, std::uint32_t source, std::vector<Complex>& Ynm)
+{
+	const OctreeNode& ti = octree.nodes[target];
+	const OctreeNode& sj = octree.nodes[source];
+	const Complex* Mj = &multipoles[source * coefficients];
+	Complex* Li = &locals[target * coefficients];
+
+	double rho, alpha, beta;
+	cartesianToSpherical(ti.centerX - sj.centerX, ti.centerY - sj.centerY, ti.centerZ - sj.centerZ, rho, alpha, beta);
+	evalLocal(rho, alpha, beta, Ynm.data());
+
+	for (int j = 0; j < terms; j++)
+	{
+		double Cnm = oddEven(j);
+		for (int k = 0; k <= j; k++)
+		{
+			Complex L(0.0, 0.0);
+			for (int n = 0; n < terms; n++)
+			{
+				for (int m = -n; m < 0; m++)
+				{
+					int jnkm = (j + n) * (j + n) + j + n + m - k;
+					L += multiply(std::conj(Mj[n * (n + 1) / 2 - m]), Ynm[jnkm]) * Cnm;
+				}
+				for (int m = 0; m <= n; m++)
+				{
+					int jnkm = (j + n) * (j + n) + j + n + m - k;
+					double Cnm2 = Cnm * oddEven((k - m) * (k < m) + m);
+					L += multiply(Mj[n * (n + 1) / 2 + m], Ynm[jnkm]) * Cnm2;
+				}
+			}
+			Li[j * (j + 1) / 2 + k] += L;
+		}
+	}
+}
+
+void FmmGravity::localToLocal(std::uint32_t parent)
+{
+	const OctreeNode& node = octree.nodes[parent];
+	const Complex* Lj = &locals[parent * coefficients];
+	std::vector<Complex> Ynm(terms * terms), YnmTheta(terms * terms);
+
+	for (std::uint32_t c = 0; c < node.childCount; c++)
+	{
+		std::uint32_t child = node.firstChild + c;
+		const OctreeNode& childNode = octree.nodes[child];
+		Complex* Li = &locals[child * coefficients];
+
+		double rho, alpha, beta;
+		cartesianToSpherical(childNode.centerX - node.centerX, childNode.centerY - node.centerY, childNode.centerZ - node.centerZ, rho, alpha, beta);
+		evalMultipole(rho, alpha, beta, Ynm.data(), YnmTheta.data());
+
+		for (int j = 0; j < terms; j++)
+		{
+			for (int k = 0; k <= j; k++)
+			{
+				Complex L(0.0, 0.0);
+				for (int n = j; n < terms; n++)
+				{
+					for (int m = j + k - n; m < 0; m++)
+					{
+						int jnkm = (n - j) * (n - j) + n - j + m - k;
+						L += multiply(std::conj(Lj[n * (n + 1) / 2 - m]), Ynm[jnkm]) * oddEven(k);
+					}
+					for (int m = 0; m <= n; m++)
+					{
+						if (n - j >= std::abs(m - k))
+						{
+							int jnkm = (n - j) * (n - j) + n - j + m - k;
+							L += multiply(Lj[n * (n + 1) / 2 + m], Ynm[jnkm]) * oddEven((m - k) * (m < k));
+						}
+					}
+				}
+				Li[j * (j + 1) / 2 + k] += L;
+			}
+		}
+	}
+}
+
+void FmmGravity::localToParticle(std::uint32_t cell, std::vector<Complex>& Ynm, std::vector<Complex>& YnmTheta)
+{
+	const OctreeNode& node = octree.nodes[cell];
+	const Complex* L = &locals[cell * coefficients];
+
+	for (std::uint32_t k = node.begin; k < node.begin + node.count; k++)
+	{
+		double r, theta, phi;
+		cartesianToSpherical(sortedX[k] - node.centerX, sortedY[k] - node.centerY, sortedZ[k] - node.centerZ, r, theta, phi);
+		if (r == 0.0)
+		{
+			// Only the constant and linear terms survive at the centre, nudge out to evaluate the gradient
+			r = 1e-12;
+		}
+		evalMultipole(r, theta, phi, Ynm.data(), YnmTheta.data());
+
+		// Gradient of the potential in spherical components (r, theta, phi)
+		double gradR = 0.0, gradTheta = 0.0, gradPhi = 0.0;
+		for (int n = 0; n < terms; n++)
+		{
+			int nm = n * n + n;
+			int nms = n * (n + 1) / 2;
+			gradR += multiply(L[nms], Ynm[nm]).real() / r * n;
+			gradTheta += multiply(L[nms], YnmTheta[nm]).real();
+			for (int m = 1; m <= n; m++)
+			{
+				nm = n * n + n + m;
+				nms = n * (n + 1) / 2 + m;
+				gradR += 2 * multiply(L[nms], Ynm[nm]).real() / r * n;
+				gradTheta += 2 * multiply(L[nms], YnmTheta[nm]).real();
+				gradPhi -= 2 * multiply(L[nms], Ynm[nm]).imag() * m;
+			}
+		}
+
+		double sinTheta = std::sin(theta), cosTheta = std::cos(theta);
+		double sinPhi = std::sin(phi), cosPhi = std::cos(phi);
+		double gx = sinTheta * cosPhi * gradR + cosTheta * cosPhi / r * gradTheta - sinPhi / r / sinTheta * gradPhi;
+		double gy = sinTheta * sinPhi * gradR + cosTheta * sinPhi / r * gradTheta + cosPhi / r / sinTheta * gradPhi;
+		double gz = cosTheta * gradR - sinTheta / r * gradTheta;
+
+		// The expansions describe sum(m / r), whose gradient points toward the mass
+		sortedAx[k] += (float)gx;
+		sortedAy[k] += (float)gy;
+		sortedAz[k] += (float)gz;
+	}
+}
+
+void FmmGravity::particleToParticle(std::uint32_t target, std::uint32_t source)
+{
+	const OctreeNode& ti = octree.nodes[target];
+	const OctreeNode& sj = octree.nodes[source];
+	const float* x = sortedX.data();
+	const float* y = sortedY.data();
+	const float* z = sortedZ.data();
+	const float* m = sortedMass.data();
+
+	const std::uint32_t count = sj.count;
+
+	for (std::uint32_t i = ti.begin; i < ti.begin + ti.count; i++)
+	{
+		accumulateSoftenedGravity(x + sj.begin, y + sj.begin, z + sj.begin, m + sj.begin, count, x[i], y[i], z[i], softening, softeningKernel, sortedAx[i], sortedAy[i], sortedAz[i]);
+	}
+}
+
+// --------------------- SPHERICAL HARMONICS ---------------------
+
+// Solid harmonics rho^n Y_n^m(alpha, beta) (suitably normalised) and their theta derivatives for degrees below terms
+void FmmGravity::evalMultipole(double rho, double alpha, double beta, Complex* Ynm, Complex* YnmTheta) const
+{
+	double x = std::cos(alpha);
+	double y = std::sin(alpha);
+	double fact = 1.0;
+	double pn = 1.0;
+	double rhom = 1.0;
+	Complex ei = std::exp(Complex(0.0, beta));
+	Complex eim(1.0, 0.0);
+
+	for (int m = 0; m < terms; m++)
+	{
+		double p = pn;
+		int npn = m * m + 2 * m;
+		int nmn = m * m;
+		Ynm[npn] = rhom * p * eim;
+		Ynm[nmn] = std::conj(Ynm[npn]);
+		double p1 = p;
+		p = x * (2 * m + 1) * p1;
+		YnmTheta[npn] = rhom * (p - (m + 1) * x * p1) / y * eim;
+		rhom *= rho;
+		double rhon = rhom;
+
+		for (int n = m + 1; n < terms; n++)
+		{
+			int npm = n * n + n + m;
+			int nmm = n * n + n - m;
+			rhon /= -(n + m);
+			Ynm[npm] = rhon * p * eim;
+			Ynm[nmm] = std::conj(Ynm[npm]);
+			double p2 = p1;
+			p1 = p;
+			p = (x * (2 * n + 1) * p1 - (n + m) * p2) / (n - m + 1);
+			YnmTheta[npm] = rhon * ((n - m + 1) * p - (n + 1) * x * p1) / y * eim;
+			rhon *= rho;
+		}
+
+		rhom /= -(2 * m + 2) * (2 * m + 1);
+		pn = -pn * fact * y;
+		fact += 2;
+		eim = multiply(eim, ei);
+	}
+}
+
+// Irregular solid harmonics rho^(-n-1) Y_n^m(alpha, beta) up to degree 2 * terms, as needed by M2L
+void FmmGravity::evalLocal(double rho, double alpha, double beta, Complex* Ynm) const
+{
+	double x = std::cos(alpha);
+	double y = std::sin(alpha);
+	double fact = 1.0;
+	double pn = 1.0;
+	double invR = -1.0 / rho;
+	double rhom = -invR;
+	Complex ei = std::exp(Complex(0.0, beta));
+	Complex eim(1.0, 0.0);
+
+	for (int m = 0; m < 2 * terms; m++)
+	{
+		double p = pn;
+		int npn = m * m + 2 * m;
+		int nmn = m * m;
+		Ynm[npn] = rhom * p * eim;
+		Ynm[nmn] = std::conj(Ynm[npn]);
+		double p1 = p;
+		p = x * (2 * m + 1) * p1;
+		rhom *= invR;
+		double rhon = rhom;
+
+		for (int n = m + 1; n < 2 * terms; n++)
+		{
+			int npm = n * n + n + m;
+			int nmm = n * n + n - m;
+			Ynm[npm] = rhon * p * eim;
+			Ynm[nmm] = std::conj(Ynm[npm]);
+			double p2 = p1;
+			p1 = p;
+			p = (x * (2 * n + 1) * p1 - (n + m) * p2) / (n - m + 1);
+			rhon *= invR * (n - m + 1);
+		}
+
+		pn = -pn * fact * y;
+		fact += 2;
+		eim = multiply(eim, ei);
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef FMM_GRAVITY_H
+#define FMM_GRAVITY_H
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "ForceSolver.h"
+#include "Octree.h"
+#include "Softening.h"
+
+// O(N) mutual gravity with the Fast Multipole Method using spherical harmonic expansions.
+// Each octree cell carries a multipole expansion (P2M, M2M upward pass), a dual-tree traversal pairs well separated
+// cells for M2L and neighbouring leaves for direct P2P sums, and local expansions are pushed down (L2L) and evaluated (L2P).
+// order is the highest harmonic degree kept, raising it trades speed for accuracy. theta is the separation criterion:
+// two cells interact through their expansions when (radius1 + radius2) < theta * distance.
+class FmmGravity : public ForceSolver
+{
+	public:
+		unsigned int order;
+		float theta;
+		float softening;
+		// Plummer by default; with the spline kernel softening is the Plummer-equivalent length
+		SofteningKernel softeningKernel;
+		unsigned int leafSize;
+
+		explicit FmmGravity(unsigned int order = 4, float theta = 0.5f, float softening = 0.0f, unsigned int leafSize = 128)
+			: order(order), theta(theta), softening(softening), softeningKernel(SOFTENING_PLUMMER), leafSize(leafSize) {}
+
+		void computeAccelerations(ParticleStore& particles) override;
+		const char* name() const override { return "fmm"; }
+
+	private:
+		typedef std::complex<double> Complex;
+
+		Octree octree;
+		// Particle data copied into tree order so every cell's particles are contiguous for the P2P loops
+		AlignedVector<float> sortedX, sortedY, sortedZ, sortedMass;
+		AlignedVector<float> sortedAx, sortedAy, sortedAz;
+		// Number of expansion terms, degree 0 .. order, only m >= 0 is stored
+		int terms;
+		int coefficients;
+		// Multipole and local coefficients, coefficients entries per cell
+		std::vector<Complex> multipoles;
+		std::vector<Complex> locals;
+
+		// Interaction lists in compressed row form, indexed by target cell
+		std::vector<std::uint32_t> m2lStart, m2lSources;
+		std::vector<std::uint32_t> p2pStart, p2pSources;
+
+		void upwardPass();
+		void traverse();
+		void interact(std::uint32_t target, std::uint32_t source, std::vector<std::uint64_t>& m2lPairs, std::vector<std::uint64_t>& p2pPairs) const;
+		void downwardPass();
+
+		void particleToMultipole(std::uint32_t cell);
+		void multipoleToMultipole(std::uint32_t parent);
+		void multipoleToLocal(std::uint32_t target, std::uint32_t source, std::vector<Complex>& Ynm);
+		void localToLocal(std::uint32_t parent);
+		void localToParticle(std::uint32_t cell, std::vector<Complex>& Ynm, std::vector<Complex>& YnmTheta);
+		void particleToParticle(std::uint32_t target, std::uint32_t source);
+
+		float cellRadius(std::uint32_t cell) const;
+
+		void evalMultipole(double rho, double alpha, double beta, Complex* Ynm, Complex* YnmTheta) const;
+		void evalLocal(double rho, double alpha, double beta, Complex* Ynm) const;
+};
+
+#endif
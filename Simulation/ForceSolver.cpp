@@ -0,0 +1,19 @@
+#include "ForceSolver.h"
+
+void ForceSolver::computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active)
+{
+	AlignedVector<float> ax(particles.ax), ay(particles.ay), az(particles.az);
+
+	computeAccelerations(particles);
+
+	for (std::uint32_t i : active)
+	{
+		ax[i] = particles.ax[i];
+		ay[i] = particles.ay[i];
+		az[i] = particles.az[i];
+	}
+
+	particles.ax.swap(ax);
+	particles.ay.swap(ay);
+	particles.az.swap(az);
+}
@@ -0,0 +1,29 @@
+#ifndef FORCE_SOLVER_H
+#define FORCE_SOLVER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "ParticleStore.h"
+
+// Simulation units use G = 1, so a body of mass 50 pulls exactly like the old gravity(..., -50.0, ...) call
+const float GRAVITATIONAL_CONSTANT = 1.0f;
+
+// Common interface for every way of turning particle positions into accelerations.
+// Solvers overwrite ax/ay/az for all particles on each call.
+class ForceSolver
+{
+	public:
+		virtual ~ForceSolver() {}
+
+		virtual void computeAccelerations(ParticleStore& particles) = 0;
+
+		// Overwrites ax/ay/az of the listed particles only, every particle still acts as a source and the rest keep their
+		// accelerations. Used by block timestep integrators. The default evaluates everything and keeps the active results.
+		virtual void computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active);
+
+		// Short identifier used by the headless driver
+		virtual const char* name() const = 0;
+};
+
+#endif
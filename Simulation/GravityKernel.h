@@ -0,0 +1,567 @@
+#ifndef GRAVITY_KERNEL_H
+#define GRAVITY_KERNEL_H
+
+#include <cmath>
+#include <cstddef>
+
+#include "Softening.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Vectorised inner loop shared by the pairwise solvers: adds the pull of j-particles [0, count) (as separate x/y/z/mass arrays)
+// on one particle at (xi, yi, zi). Works 16 (AVX-512) or 8 (AVX2) j-lanes at a time with a reciprocal square root estimate
+// refined by one Newton step. Zero separations (the particle itself) contribute nothing. The result is not multiplied by G.
+
+#if defined(__AVX2__)
+// Adds the 8 lanes of v together
+inline float horizontalSum(__m256 v)
+{
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+	return _mm_cvtss_f32(sum);
+}
+#endif
+
+#if defined(__AVX512F__)
+// Adds the 16 lanes of v together
+inline float horizontalSum(__m512 v)
+{
+	alignas(64) float lanes[16];
+	_mm512_store_ps(lanes, v);
+	return horizontalSum(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+}
+#endif
+
+inline const char* gravityKernelName()
+{
+#if defined(__AVX512F__)
+	return "avx512";
+#elif defined(__AVX2__)
+	return "avx2";
+#else
+	return "scalar";
+#endif
+}
+
+inline void accumulateGravity(const float* x, const float* y, const float* z, const float* m, std::size_t count,
+	float xi, float yi, float zi, float eps2, float& outX, float& outY, float& outZ)
+{
+	std::size_t j = 0;
+	float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+
+#if defined(__AVX512F__)
+	const __m512 xiv = _mm512_set1_ps(xi);
+	const __m512 yiv = _mm512_set1_ps(yi);
+	const __m512 ziv = _mm512_set1_ps(zi);
+	const __m512 soft = _mm512_set1_ps(eps2);
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512 threeHalves = _mm512_set1_ps(1.5f);
+	__m512 vx = _mm512_setzero_ps();
+	__m512 vy = _mm512_setzero_ps();
+	__m512 vz = _mm512_setzero_ps();
+
+	// Whole registers, then one masked register for the remainder
+	for (; j < count; j += 16)
+	{
+		__mmask16 lanes = count - j >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - j)) - 1);
+		__m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, x + j), xiv);
+		__m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, y + j), yiv);
+		__m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, z + j), ziv);
+
+		__m512 r2 = _mm512_fmadd_ps(dx, dx, soft);
+		r2 = _mm512_fmadd_ps(dy, dy, r2);
+		r2 = _mm512_fmadd_ps(dz, dz, r2);
+
+		__mmask16 nonZero = _mm512_cmp_ps_mask(r2, _mm512_setzero_ps(), _CMP_GT_OQ);
+		__m512 invR = _mm512_maskz_rsqrt14_ps(nonZero, r2);
+		invR = _mm512_mul_ps(invR, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(invR, invR), threeHalves));
+
+		__m512 s = _mm512_mul_ps(_mm512_maskz_loadu_ps(lanes, m + j), _mm512_mul_ps(invR, _mm512_mul_ps(invR, invR)));
+		vx = _mm512_fmadd_ps(dx, s, vx);
+		vy = _mm512_fmadd_ps(dy, s, vy);
+		vz = _mm512_fmadd_ps(dz, s, vz);
+	}
+
+	accX = horizontalSum(vx);
+	accY = horizontalSum(vy);
+	accZ = horizontalSum(vz);
+#else
+#if defined(__AVX2__)
+	const __m256 xiv = _mm256_set1_ps(xi);
+	const __m256 yiv = _mm256_set1_ps(yi);
+	const __m256 ziv = _mm256_set1_ps(zi);
+	const __m256 soft = _mm256_set1_ps(eps2);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+	__m256 vx = _mm256_setzero_ps();
+	__m256 vy = _mm256_setzero_ps();
+	__m256 vz = _mm256_setzero_ps();
+
+	for (; j + 8 <= count; j += 8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xiv);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yiv);
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), ziv);
+
+		__m256 r2 = _mm256_fmadd_ps(dx, dx, soft);
+		r2 = _mm256_fmadd_ps(dy, dy, r2);
+		r2 = _mm256_fmadd_ps(dz, dz, r2);
+
+		__m256 nonZero = _mm256_cmp_ps(r2, zero, _CMP_GT_OQ);
+		__m256 invR = _mm256_and_ps(_mm256_rsqrt_ps(r2), nonZero);
+		invR = _mm256_mul_ps(invR, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(invR, invR), threeHalves));
+
+		__m256 s = _mm256_mul_ps(_mm256_loadu_ps(m + j), _mm256_mul_ps(invR, _mm256_mul_ps(invR, invR)));
+		vx = _mm256_fmadd_ps(dx, s, vx);
+		vy = _mm256_fmadd_ps(dy, s, vy);
+		vz = _mm256_fmadd_ps(dz, s, vz);
+	}
+
+	accX = horizontalSum(vx);
+	accY = horizontalSum(vy);
+	accZ = horizontalSum(vz);
+#endif
+	// Scalar remainder (or the whole loop without AVX2)
+	for (; j < count; j++)
+	{
+		float dx = x[j] - xi;
+		float dy = y[j] - yi;
+		float dz = z[j] - zi;
+		float r2 = dx * dx + dy * dy + dz * dz + eps2;
+
+		if (r2 > 0.0f)
+		{
+			float invR = 1.0f / std::sqrt(r2);
+			float s = m[j] * invR * invR * invR;
+			accX += dx * s;
+			accY += dy * s;
+			accZ += dz * s;
+		}
+	}
+#endif
+
+	outX += accX;
+	outY += accY;
+	outZ += accZ;
+}
+
+// Same sum with the cubic spline kernel of radius h = 1 / invH (see Softening.h) in place of Plummer softening. Pairs
+// further apart than h get the plain Newtonian force; the spline polynomial is only evaluated for registers that have
+// a lane inside h, so away from close encounters this costs the same as the unsoftened kernel.
+inline void accumulateGravitySpline(const float* x, const float* y, const float* z, const float* m, std::size_t count,
+	float xi, float yi, float zi, float invH, float& outX, float& outY, float& outZ)
+{
+	std::size_t j = 0;
+	float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+	const float h2 = 1.0f / (invH * invH);
+
+#if defined(__AVX512F__)
+	const __m512 xiv = _mm512_set1_ps(xi);
+	const __m512 yiv = _mm512_set1_ps(yi);
+	const __m512 ziv = _mm512_set1_ps(zi);
+	const __m512 radius2 = _mm512_set1_ps(h2);
+	const __m512 inverseRadius = _mm512_set1_ps(invH);
+	const __m512 inverseRadius3 = _mm512_set1_ps(invH * invH * invH);
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512 threeHalves = _mm512_set1_ps(1.5f);
+	__m512 vx = _mm512_setzero_ps();
+	__m512 vy = _mm512_setzero_ps();
+	__m512 vz = _mm512_setzero_ps();
+
+	for (; j < count; j += 16)
+	{
+		__mmask16 lanes = count - j >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - j)) - 1);
+		__m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, x + j), xiv);
+		__m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, y + j), yiv);
+		__m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, z + j), ziv);
+
+		__m512 r2 = _mm512_mul_ps(dx, dx);
+		r2 = _mm512_fmadd_ps(dy, dy, r2);
+		r2 = _mm512_fmadd_ps(dz, dz, r2);
+
+		__mmask16 nonZero = _mm512_cmp_ps_mask(r2, _mm512_setzero_ps(), _CMP_GT_OQ);
+		__m512 invR = _mm512_maskz_rsqrt14_ps(nonZero, r2);
+		invR = _mm512_mul_ps(invR, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(invR, invR), threeHalves));
+		__m512 factor = _mm512_mul_ps(invR, _mm512_mul_ps(invR, invR));
+
+		__mmask16 inside = _mm512_mask_cmp_ps_mask(lanes, r2, radius2, _CMP_LT_OQ);
+		if (inside)
+		{
+			__m512 u = _mm512_mul_ps(_mm512_mul_ps(r2, invR), inverseRadius);
+			__m512 inner = _mm512_fmadd_ps(_mm512_mul_ps(u, u), _mm512_fmsub_ps(_mm512_set1_ps(32.0f), u, _mm512_set1_ps(38.4f)), _mm512_set1_ps(10.666667f));
+			__m512 outer = _mm512_fnmadd_ps(_mm512_set1_ps(10.666667f), u, _mm512_set1_ps(38.4f));
+			outer = _mm512_fmadd_ps(outer, u, _mm512_set1_ps(-48.0f));
+			outer = _mm512_fmadd_ps(outer, u, _mm512_set1_ps(21.333333f));
+			outer = _mm512_fnmadd_ps(_mm512_set1_ps(0.06666667f), factor, _mm512_mul_ps(outer, inverseRadius3));
+			__mmask16 core = _mm512_cmp_ps_mask(u, half, _CMP_LT_OQ);
+			__m512 spline = _mm512_mask_blend_ps(core, outer, _mm512_mul_ps(inner, inverseRadius3));
+			factor = _mm512_mask_blend_ps(inside, factor, spline);
+		}
+
+		__m512 s = _mm512_mul_ps(_mm512_maskz_loadu_ps(lanes, m + j), factor);
+		vx = _mm512_fmadd_ps(dx, s, vx);
+		vy = _mm512_fmadd_ps(dy, s, vy);
+		vz = _mm512_fmadd_ps(dz, s, vz);
+	}
+
+	accX = horizontalSum(vx);
+	accY = horizontalSum(vy);
+	accZ = horizontalSum(vz);
+#else
+#if defined(__AVX2__)
+	const __m256 xiv = _mm256_set1_ps(xi);
+	const __m256 yiv = _mm256_set1_ps(yi);
+	const __m256 ziv = _mm256_set1_ps(zi);
+	const __m256 radius2 = _mm256_set1_ps(h2);
+	const __m256 inverseRadius = _mm256_set1_ps(invH);
+	const __m256 inverseRadius3 = _mm256_set1_ps(invH * invH * invH);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+	__m256 vx = _mm256_setzero_ps();
+	__m256 vy = _mm256_setzero_ps();
+	__m256 vz = _mm256_setzero_ps();
+
+	for (; j + 8 <= count; j += 8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xiv);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yiv);
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), ziv);
+
+		__m256 r2 = _mm256_mul_ps(dx, dx);
+		r2 = _mm256_fmadd_ps(dy, dy, r2);
+		r2 = _mm256_fmadd_ps(dz, dz, r2);
+
+		__m256 nonZero = _mm256_cmp_ps(r2, zero, _CMP_GT_OQ);
+		__m256 invR = _mm256_and_ps(_mm256_rsqrt_ps(r2), nonZero);
+		invR = _mm256_mul_ps(invR, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(invR, invR), threeHalves));
+		__m256 factor = _mm256_mul_ps(invR, _mm256_mul_ps(invR, invR));
+
+		__m256 inside = _mm256_cmp_ps(r2, radius2, _CMP_LT_OQ);
+		if (_mm256_movemask_ps(inside))
+		{
+			__m256 u = _mm256_mul_ps(_mm256_mul_ps(r2, invR), inverseRadius);
+			__m256 inner = _mm256_fmadd_ps(_mm256_mul_ps(u, u), _mm256_fmsub_ps(_mm256_set1_ps(32.0f), u, _mm256_set1_ps(38.4f)), _mm256_set1_ps(10.666667f));
+			__m256 outer = _mm256_fnmadd_ps(_mm256_set1_ps(10.666667f), u, _mm256_set1_ps(38.4f));
+			outer = _mm256_fmadd_ps(outer, u, _mm256_set1_ps(-48.0f));
+			outer = _mm256_fmadd_ps(outer, u, _mm256_set1_ps(21.333333f));
+			outer = _mm256_fnmadd_ps(_mm256_set1_ps(0.06666667f), factor, _mm256_mul_ps(outer, inverseRadius3));
+			__m256 core = _mm256_cmp_ps(u, half, _CMP_LT_OQ);
+			__m256 spline = _mm256_blendv_ps(outer, _mm256_mul_ps(inner, inverseRadius3), core);
+			factor = _mm256_blendv_ps(factor, spline, inside);
+		}
+
+		__m256 s = _mm256_mul_ps(_mm256_loadu_ps(m + j), factor);
+		vx = _mm256_fmadd_ps(dx, s, vx);
+		vy = _mm256_fmadd_ps(dy, s, vy);
+		vz = _mm256_fmadd_ps(dz, s, vz);
+	}
+
+	accX = horizontalSum(vx);
+	accY = horizontalSum(vy);
+	accZ = horizontalSum(vz);
+#endif
+	for (; j < count; j++)
+	{
+		float dx = x[j] - xi;
+		float dy = y[j] - yi;
+		float dz = z[j] - zi;
+		float r2 = dx * dx + dy * dy + dz * dz;
+
+		if (r2 > 0.0f)
+		{
+			float s = m[j] * (r2 < h2 ? splineForceFactor(std::sqrt(r2), invH) : 1.0f / (r2 * std::sqrt(r2)));
+			accX += dx * s;
+			accY += dy * s;
+			accZ += dz * s;
+		}
+	}
+#endif
+
+	outX += accX;
+	outY += accY;
+	outZ += accZ;
+}
+
+// Picks the kernel for a solver's softening settings: Plummer with eps^2, or the spline of radius 2.8 * softening
+inline void accumulateSoftenedGravity(const float* x, const float* y, const float* z, const float* m, std::size_t count,
+	float xi, float yi, float zi, float softening, SofteningKernel kernel, float& outX, float& outY, float& outZ)
+{
+	if (kernel == SOFTENING_SPLINE && softening > 0.0f)
+	{
+		accumulateGravitySpline(x, y, z, m, count, xi, yi, zi, 1.0f / (SPLINE_RADIUS_PER_SOFTENING * softening), outX, outY, outZ);
+	}
+	else
+	{
+		accumulateGravity(x, y, z, m, count, xi, yi, zi, softening * softening, outX, outY, outZ);
+	}
+}
+
+// Force and jerk together for the Hermite integrator, from the same j-particle layout plus velocities. Adds
+// sum m d / r^3 to acc[0..2] and sum m (dv / r^3 - 3 (d . dv) d / r^5) to jerk[0..2], with d and dv the separation and
+// relative velocity of each j-particle. Same lane widths, reciprocal square root and zero-separation masking as above.
+inline void accumulateGravityJerk(const float* x, const float* y, const float* z, const float* vx, const float* vy, const float* vz,
+	const float* m, std::size_t count, float xi, float yi, float zi, float vxi, float vyi, float vzi, float eps2, float* acc, float* jerk)
+{
+	std::size_t j = 0;
+	float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+	float jerkX = 0.0f, jerkY = 0.0f, jerkZ = 0.0f;
+
+#if defined(__AVX512F__)
+	const __m512 xiv = _mm512_set1_ps(xi);
+	const __m512 yiv = _mm512_set1_ps(yi);
+	const __m512 ziv = _mm512_set1_ps(zi);
+	const __m512 vxiv = _mm512_set1_ps(vxi);
+	const __m512 vyiv = _mm512_set1_ps(vyi);
+	const __m512 vziv = _mm512_set1_ps(vzi);
+	const __m512 soft = _mm512_set1_ps(eps2);
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512 three = _mm512_set1_ps(3.0f);
+	const __m512 threeHalves = _mm512_set1_ps(1.5f);
+	__m512 ax = _mm512_setzero_ps(), ay = _mm512_setzero_ps(), az = _mm512_setzero_ps();
+	__m512 jx = _mm512_setzero_ps(), jy = _mm512_setzero_ps(), jz = _mm512_setzero_ps();
+
+	for (; j < count; j += 16)
+	{
+		__mmask16 lanes = count - j >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - j)) - 1);
+		__m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, x + j), xiv);
+		__m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, y + j), yiv);
+		__m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, z + j), ziv);
+		__m512 dvx = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, vx + j), vxiv);
+		__m512 dvy = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, vy + j), vyiv);
+		__m512 dvz = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, vz + j), vziv);
+
+		__m512 r2 = _mm512_fmadd_ps(dx, dx, soft);
+		r2 = _mm512_fmadd_ps(dy, dy, r2);
+		r2 = _mm512_fmadd_ps(dz, dz, r2);
+		__m512 rv = _mm512_mul_ps(dx, dvx);
+		rv = _mm512_fmadd_ps(dy, dvy, rv);
+		rv = _mm512_fmadd_ps(dz, dvz, rv);
+
+		__mmask16 nonZero = _mm512_cmp_ps_mask(r2, _mm512_setzero_ps(), _CMP_GT_OQ);
+		__m512 invR = _mm512_maskz_rsqrt14_ps(nonZero, r2);
+		invR = _mm512_mul_ps(invR, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(invR, invR), threeHalves));
+		__m512 invR2 = _mm512_mul_ps(invR, invR);
+
+		__m512 s = _mm512_mul_ps(_mm512_maskz_loadu_ps(lanes, m + j), _mm512_mul_ps(invR, invR2));
+		__m512 alpha = _mm512_mul_ps(three, _mm512_mul_ps(rv, invR2));
+		ax = _mm512_fmadd_ps(dx, s, ax);
+		ay = _mm512_fmadd_ps(dy, s, ay);
+		az = _mm512_fmadd_ps(dz, s, az);
+		jx = _mm512_fmadd_ps(_mm512_fnmadd_ps(alpha, dx, dvx), s, jx);
+		jy = _mm512_fmadd_ps(_mm512_fnmadd_ps(alpha, dy, dvy), s, jy);
+		jz = _mm512_fmadd_ps(_mm512_fnmadd_ps(alpha, dz, dvz), s, jz);
+	}
+
+	accX = horizontalSum(ax);
+	accY = horizontalSum(ay);
+	accZ = horizontalSum(az);
+	jerkX = horizontalSum(jx);
+	jerkY = horizontalSum(jy);
+	jerkZ = horizontalSum(jz);
+#else
+#if defined(__AVX2__)
+	const __m256 xiv = _mm256_set1_ps(xi);
+	const __m256 yiv = _mm256_set1_ps(yi);
+	const __m256 ziv = _mm256_set1_ps(zi);
+	const __m256 vxiv = _mm256_set1_ps(vxi);
+	const __m256 vyiv = _mm256_set1_ps(vyi);
+	const __m256 vziv = _mm256_set1_ps(vzi);
+	const __m256 soft = _mm256_set1_ps(eps2);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 three = _mm256_set1_ps(3.0f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+	__m256 ax = _mm256_setzero_ps(), ay = _mm256_setzero_ps(), az = _mm256_setzero_ps();
+	__m256 jx = _mm256_setzero_ps(), jy = _mm256_setzero_ps(), jz = _mm256_setzero_ps();
+
+	for (; j + 8 <= count; j += 8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xiv);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yiv);
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), ziv);
+		__m256 dvx = _mm256_sub_ps(_mm256_loadu_ps(vx + j), vxiv);
+		__m256 dvy = _mm256_sub_ps(_mm256_loadu_ps(vy + j), vyiv);
+		__m256 dvz = _mm256_sub_ps(_mm256_loadu_ps(vz + j), vziv);
+
+		__m256 r2 = _mm256_fmadd_ps(dx, dx, soft);
+		r2 = _mm256_fmadd_ps(dy, dy, r2);
+		r2 = _mm256_fmadd_ps(dz, dz, r2);
+		__m256 rv = _mm256_mul_ps(dx, dvx);
+		rv = _mm256_fmadd_ps(dy, dvy, rv);
+		rv = _mm256_fmadd_ps(dz, dvz, rv);
+
+		__m256 nonZero = _mm256_cmp_ps(r2, zero, _CMP_GT_OQ);
+		__m256 invR = _mm256_and_ps(_mm256_rsqrt_ps(r2), nonZero);
+		invR = _mm256_mul_ps(invR, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(invR, invR), threeHalves));
+		__m256 invR2 = _mm256_mul_ps(invR, invR);
+
+		__m256 s = _mm256_mul_ps(_mm256_loadu_ps(m + j), _mm256_mul_ps(invR, invR2));
+		__m256 alpha = _mm256_mul_ps(three, _mm256_mul_ps(rv, invR2));
+		ax = _mm256_fmadd_ps(dx, s, ax);
+		ay = _mm256_fmadd_ps(dy, s, ay);
+		az = _mm256_fmadd_ps(dz, s, az);
+		jx = _mm256_fmadd_ps(_mm256_fnmadd_ps(alpha, dx, dvx), s, jx);
+		jy = _mm256_fmadd_ps(_mm256_fnmadd_ps(alpha, dy, dvy), s, jy);
+		jz = _mm256_fmadd_ps(_mm256_fnmadd_ps(alpha, dz, dvz), s, jz);
+	}
+
+	accX = horizontalSum(ax);
+	accY = horizontalSum(ay);
+	accZ = horizontalSum(az);
+	jerkX = horizontalSum(jx);
+	jerkY = horizontalSum(jy);
+	jerkZ = horizontalSum(jz);
+#endif
+	for (; j < count; j++)
+	{
+		float dx = x[j] - xi, dy = y[j] - yi, dz = z[j] - zi;
+		float dvx = vx[j] - vxi, dvy = vy[j] - vyi, dvz = vz[j] - vzi;
+		float r2 = dx * dx + dy * dy + dz * dz + eps2;
+
+		if (r2 > 0.0f)
+		{
+			float invR = 1.0f / std::sqrt(r2);
+			float invR2 = invR * invR;
+			float s = m[j] * invR * invR2;
+			float alpha = 3.0f * (dx * dvx + dy * dvy + dz * dvz) * invR2;
+			accX += dx * s;
+			accY += dy * s;
+			accZ += dz * s;
+			jerkX += (dvx - alpha * dx) * s;
+			jerkY += (dvy - alpha * dy) * s;
+			jerkZ += (dvz - alpha * dz) * s;
+		}
+	}
+#endif
+
+	acc[0] += accX;
+	acc[1] += accY;
+	acc[2] += accZ;
+	jerk[0] += jerkX;
+	jerk[1] += jerkY;
+	jerk[2] += jerkZ;
+}
+
+
+// The transposed loop for a handful of sources pulling on many particles: stores scale times the pull of the bodies
+// [0, bodies) on every particle [0, count) into outX/Y/Z. Here the lanes hold 16 (AVX-512) or 8 (AVX2) target particles,
+// which stay in registers with their accumulators while every body is broadcast in turn from arrays small enough to
+// live in L1, so there is no horizontal sum and no wasted lanes however few bodies there are. Plummer softening only.
+inline void accumulateFromBodies(const float* bx, const float* by, const float* bz, const float* bm, std::size_t bodies,
+	const float* x, const float* y, const float* z, std::size_t count, float eps2, float scale, float* outX, float* outY, float* outZ)
+{
+	std::size_t i = 0;
+
+#if defined(__AVX512F__)
+	const __m512 soft = _mm512_set1_ps(eps2);
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512 threeHalves = _mm512_set1_ps(1.5f);
+	const __m512 factor = _mm512_set1_ps(scale);
+
+	for (; i < count; i += 16)
+	{
+		__mmask16 lanes = count - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - i)) - 1);
+		__m512 xi = _mm512_maskz_loadu_ps(lanes, x + i);
+		__m512 yi = _mm512_maskz_loadu_ps(lanes, y + i);
+		__m512 zi = _mm512_maskz_loadu_ps(lanes, z + i);
+		__m512 vx = _mm512_setzero_ps();
+		__m512 vy = _mm512_setzero_ps();
+		__m512 vz = _mm512_setzero_ps();
+
+		for (std::size_t j = 0; j < bodies; j++)
+		{
+			__m512 dx = _mm512_sub_ps(_mm512_set1_ps(bx[j]), xi);
+			__m512 dy = _mm512_sub_ps(_mm512_set1_ps(by[j]), yi);
+			__m512 dz = _mm512_sub_ps(_mm512_set1_ps(bz[j]), zi);
+
+			__m512 r2 = _mm512_fmadd_ps(dx, dx, soft);
+			r2 = _mm512_fmadd_ps(dy, dy, r2);
+			r2 = _mm512_fmadd_ps(dz, dz, r2);
+
+			__mmask16 nonZero = _mm512_cmp_ps_mask(r2, _mm512_setzero_ps(), _CMP_GT_OQ);
+			__m512 invR = _mm512_maskz_rsqrt14_ps(nonZero, r2);
+			invR = _mm512_mul_ps(invR, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(invR, invR), threeHalves));
+
+			__m512 s = _mm512_mul_ps(_mm512_set1_ps(bm[j]), _mm512_mul_ps(invR, _mm512_mul_ps(invR, invR)));
+			vx = _mm512_fmadd_ps(dx, s, vx);
+			vy = _mm512_fmadd_ps(dy, s, vy);
+			vz = _mm512_fmadd_ps(dz, s, vz);
+		}
+
+		_mm512_mask_storeu_ps(outX + i, lanes, _mm512_mul_ps(vx, factor));
+		_mm512_mask_storeu_ps(outY + i, lanes, _mm512_mul_ps(vy, factor));
+		_mm512_mask_storeu_ps(outZ + i, lanes, _mm512_mul_ps(vz, factor));
+	}
+#elif defined(__AVX2__)
+	const __m256 soft = _mm256_set1_ps(eps2);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+	const __m256 factor = _mm256_set1_ps(scale);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 xi = _mm256_loadu_ps(x + i);
+		__m256 yi = _mm256_loadu_ps(y + i);
+		__m256 zi = _mm256_loadu_ps(z + i);
+		__m256 vx = _mm256_setzero_ps();
+		__m256 vy = _mm256_setzero_ps();
+		__m256 vz = _mm256_setzero_ps();
+
+		for (std::size_t j = 0; j < bodies; j++)
+		{
+			__m256 dx = _mm256_sub_ps(_mm256_set1_ps(bx[j]), xi);
+			__m256 dy = _mm256_sub_ps(_mm256_set1_ps(by[j]), yi);
+			__m256 dz = _mm256_sub_ps(_mm256_set1_ps(bz[j]), zi);
+
+			__m256 r2 = _mm256_fmadd_ps(dx, dx, soft);
+			r2 = _mm256_fmadd_ps(dy, dy, r2);
+			r2 = _mm256_fmadd_ps(dz, dz, r2);
+
+			__m256 nonZero = _mm256_cmp_ps(r2, zero, _CMP_GT_OQ);
+			__m256 invR = _mm256_and_ps(_mm256_rsqrt_ps(r2), nonZero);
+			invR = _mm256_mul_ps(invR, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(invR, invR), threeHalves));
+
+			__m256 s = _mm256_mul_ps(_mm256_set1_ps(bm[j]), _mm256_mul_ps(invR, _mm256_mul_ps(invR, invR)));
+			vx = _mm256_fmadd_ps(dx, s, vx);
+			vy = _mm256_fmadd_ps(dy, s, vy);
+			vz = _mm256_fmadd_ps(dz, s, vz);
+		}
+
+		_mm256_storeu_ps(outX + i, _mm256_mul_ps(vx, factor));
+		_mm256_storeu_ps(outY + i, _mm256_mul_ps(vy, factor));
+		_mm256_storeu_ps(outZ + i, _mm256_mul_ps(vz, factor));
+	}
+#endif
+	// Scalar remainder (or the whole loop without AVX2)
+	for (; i < count; i++)
+	{
+		float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+		for (std::size_t j = 0; j < bodies; j++)
+		{
+			float dx = bx[j] - x[i];
+			float dy = by[j] - y[i];
+			float dz = bz[j] - z[i];
+			float r2 = dx * dx + dy * dy + dz * dz + eps2;
+
+			if (r2 > 0.0f)
+			{
+				float invR = 1.0f / std::sqrt(r2);
+				float s = bm[j] * invR * invR * invR;
+				accX += dx * s;
+				accY += dy * s;
+				accZ += dz * s;
+			}
+		}
+		outX[i] = scale * accX;
+		outY[i] = scale * accY;
+		outZ[i] = scale * accZ;
+	}
+}
+
+#endif
@@ -0,0 +1,227 @@
+#include "HermiteIntegrator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "GravityKernel.h"
+#include "Parallel.h"
+
+// Starting step eta_s |a| / |a'| before there are higher derivatives for the Aarseth criterion
+static const double START_ETA = 0.01;
+// Particles per chunk of the prediction sweep
+static const std::size_t PREDICT_GRAIN = 16384;
+
+HermiteIntegrator::HermiteIntegrator(float softening, float eta, unsigned int maxLevel)
+	: softening(softening), eta(eta), maxLevel(std::min(maxLevel, MAX_LEVEL)), primed(false), primedLevel(0)
+{
+}
+
+unsigned int HermiteIntegrator::deepestBin() const
+{
+	for (unsigned int k = maxLevel; k > 0; k--)
+	{
+		if (occupancy[k] > 0)
+		{
+			return k;
+		}
+	}
+	return 0;
+}
+
+unsigned int HermiteIntegrator::binFor(float dt, double wanted) const
+{
+	if (!(wanted < dt))
+	{
+		return 0;
+	}
+	if (!(wanted > 0.0))
+	{
+		return maxLevel;
+	}
+	int level = (int)std::ceil(std::log2(dt / wanted));
+	return (unsigned int)std::max(0, std::min((int)maxLevel, level));
+}
+
+void HermiteIntegrator::forceAndJerk(const ParticleStore& particles, std::uint32_t i, float* acc, float* jerk) const
+{
+	acc[0] = acc[1] = acc[2] = 0.0f;
+	jerk[0] = jerk[1] = jerk[2] = 0.0f;
+	accumulateGravityJerk(predX.data(), predY.data(), predZ.data(), predVX.data(), predVY.data(), predVZ.data(), particles.mass.data(),
+		particles.paddedSize(), predX[i], predY[i], predZ[i], predVX[i], predVY[i], predVZ[i], softening * softening, acc, jerk);
+	for (int c = 0; c < 3; c++)
+	{
+		acc[c] *= GRAVITATIONAL_CONSTANT;
+		jerk[c] *= GRAVITATIONAL_CONSTANT;
+	}
+}
+
+void HermiteIntegrator::predict(const ParticleStore& particles, std::uint32_t tick, float tickLength)
+{
+	parallelFor(0, particles.size(), PREDICT_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+		{
+			float h = (tick - lastTick[i]) * tickLength;
+			float h2 = 0.5f * h * h;
+			float h3 = h2 * h * (1.0f / 3.0f);
+
+			predX[i] = particles.x[i] + particles.vx[i] * h + particles.ax[i] * h2 + jx[i] * h3;
+			predY[i] = particles.y[i] + particles.vy[i] * h + particles.ay[i] * h2 + jy[i] * h3;
+			predZ[i] = particles.z[i] + particles.vz[i] * h + particles.az[i] * h2 + jz[i] * h3;
+			predVX[i] = particles.vx[i] + particles.ax[i] * h + jx[i] * h2;
+			predVY[i] = particles.vy[i] + particles.ay[i] * h + jy[i] * h2;
+			predVZ[i] = particles.vz[i] + particles.az[i] * h + jz[i] * h2;
+		}
+	});
+}
+
+void HermiteIntegrator::prime(ParticleStore& particles, float dt)
+{
+	std::size_t n = particles.size();
+
+	// Padding entries sit at the origin with zero velocity and mass
+	predX.assign(particles.x.begin(), particles.x.end());
+	predY.assign(particles.y.begin(), particles.y.end());
+	predZ.assign(particles.z.begin(), particles.z.end());
+	predVX.assign(particles.vx.begin(), particles.vx.end());
+	predVY.assign(particles.vy.begin(), particles.vy.end());
+	predVZ.assign(particles.vz.begin(), particles.vz.end());
+	jx.assign(n, 0.0f);
+	jy.assign(n, 0.0f);
+	jz.assign(n, 0.0f);
+	lastTick.assign(n, 0);
+	bins.assign(n, 0);
+	occupancy.assign(MAX_LEVEL + 1, 0);
+
+	parallelFor(0, n, 64, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+		{
+			float acc[3], jerk[3];
+			forceAndJerk(particles, (std::uint32_t)i, acc, jerk);
+			particles.ax[i] = acc[0];
+			particles.ay[i] = acc[1];
+			particles.az[i] = acc[2];
+			jx[i] = jerk[0];
+			jy[i] = jerk[1];
+			jz[i] = jerk[2];
+		}
+	});
+	forceEvaluations += n;
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		double a = std::sqrt((double)particles.ax[i] * particles.ax[i] + (double)particles.ay[i] * particles.ay[i] + (double)particles.az[i] * particles.az[i]);
+		double j = std::sqrt((double)jx[i] * jx[i] + (double)jy[i] * jy[i] + (double)jz[i] * jz[i]);
+		bins[i] = (std::uint8_t)(j > 0.0 ? binFor(dt, START_ETA * a / j) : 0);
+		occupancy[bins[i]]++;
+	}
+
+	primed = true;
+	primedLevel = maxLevel;
+}
+
+void HermiteIntegrator::step(ParticleStore& particles, ForceSolver&, float dt)
+{
+	std::size_t n = particles.size();
+	if (n == 0)
+	{
+		return;
+	}
+
+	maxLevel = std::min(maxLevel, MAX_LEVEL);
+	if (!primed || bins.size() != n || primedLevel != maxLevel || predX.size() != particles.paddedSize())
+	{
+		prime(particles, dt);
+	}
+
+	const std::uint32_t ticks = 1u << maxLevel;
+	const float tickLength = dt / ticks;
+	std::fill(lastTick.begin(), lastTick.end(), 0);
+
+	std::uint32_t tick = 0;
+	while (tick < ticks)
+	{
+		std::uint32_t finest = ticks >> deepestBin();
+		tick = (tick / finest + 1) * finest;
+
+		predict(particles, tick, tickLength);
+
+		active.clear();
+		for (std::uint32_t i = 0; i < n; i++)
+		{
+			if (tick % (ticks >> bins[i]) == 0)
+			{
+				active.push_back(i);
+			}
+		}
+
+		newA.resize(3 * active.size());
+		newJ.resize(3 * active.size());
+		parallelFor(0, active.size(), 16, [&](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t k = begin; k < end; k++)
+			{
+				forceAndJerk(particles, active[k], &newA[3 * k], &newJ[3 * k]);
+			}
+		});
+		forceEvaluations += active.size();
+
+		for (std::size_t k = 0; k < active.size(); k++)
+		{
+			std::uint32_t i = active[k];
+			unsigned int bin = bins[i];
+			double h = (double)(ticks >> bin) * tickLength;
+
+			float* position[3] = { &particles.x[i], &particles.y[i], &particles.z[i] };
+			float* velocity[3] = { &particles.vx[i], &particles.vy[i], &particles.vz[i] };
+			float* acceleration[3] = { &particles.ax[i], &particles.ay[i], &particles.az[i] };
+			float* jerk[3] = { &jx[i], &jy[i], &jz[i] };
+			const float predicted[3] = { predX[i], predY[i], predZ[i] };
+			const float predictedV[3] = { predVX[i], predVY[i], predVZ[i] };
+
+			// Snap and crackle from the Hermite interpolation of a and a' across the step, then the corrector
+			double a1Norm2 = 0.0, j1Norm2 = 0.0, snap2 = 0.0, crackle2 = 0.0;
+			for (int c = 0; c < 3; c++)
+			{
+				double a0 = *acceleration[c], j0 = *jerk[c];
+				double a1 = newA[3 * k + c], j1 = newJ[3 * k + c];
+
+				double snap = (-6.0 * (a0 - a1) - h * (4.0 * j0 + 2.0 * j1)) / (h * h);
+				double crackle = (12.0 * (a0 - a1) + 6.0 * h * (j0 + j1)) / (h * h * h);
+
+				double h2 = h * h;
+				*position[c] = (float)(predicted[c] + snap * h2 * h2 / 24.0 + crackle * h2 * h2 * h / 120.0);
+				*velocity[c] = (float)(predictedV[c] + snap * h2 * h / 6.0 + crackle * h2 * h2 / 24.0);
+				*acceleration[c] = (float)a1;
+				*jerk[c] = (float)j1;
+
+				// Snap at the end of the step for the timestep criterion
+				double snapEnd = snap + crackle * h;
+				a1Norm2 += a1 * a1;
+				j1Norm2 += j1 * j1;
+				snap2 += snapEnd * snapEnd;
+				crackle2 += crackle * crackle;
+			}
+			lastTick[i] = tick;
+
+			double numerator = std::sqrt(a1Norm2 * snap2) + j1Norm2;
+			double denominator = std::sqrt(j1Norm2 * crackle2) + snap2;
+			double wanted = denominator > 0.0 ? std::sqrt(eta * numerator / denominator) : dt;
+
+			// Deeper bins are always allowed, shallower ones one level at a time and only on a boundary of that bin
+			unsigned int next = binFor(dt, wanted);
+			if (next < bin)
+			{
+				next = bin - 1;
+				if (tick % (ticks >> next) != 0)
+				{
+					next = bin;
+				}
+			}
+			occupancy[bin]--;
+			occupancy[next]++;
+			bins[i] = (std::uint8_t)next;
+		}
+	}
+}
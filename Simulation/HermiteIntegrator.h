@@ -0,0 +1,58 @@
+#ifndef HERMITE_INTEGRATOR_H
+#define HERMITE_INTEGRATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Integrator.h"
+
+// 4th-order Hermite predictor-corrector with block timesteps, the standard scheme for collisional systems such as
+// star clusters. Forces and jerks are summed directly over all particles in one vectorised pass
+// (accumulateGravityJerk), so the simulation's force solver is not used. Each particle sits in a power-of-two bin of
+// the outer step; at every block time all particles are predicted to third order, the active ones get a new force and
+// jerk, are corrected with the interpolated snap and crackle, and pick their next step with the Aarseth criterion
+// sqrt(eta (|a| |a''| + |a'|^2) / (|a'| |a'''| + |a''|^2)). All particles are synchronised at the end of each step.
+class HermiteIntegrator : public Integrator
+{
+	public:
+		// Plummer softening length of the direct sum
+		float softening;
+		// Aarseth accuracy parameter
+		float eta;
+		// Deepest bin, the smallest step is dt / 2^maxLevel
+		unsigned int maxLevel;
+
+		explicit HermiteIntegrator(float softening = 0.0f, float eta = 0.02f, unsigned int maxLevel = 16);
+
+		void step(ParticleStore& particles, ForceSolver& solver, float dt) override;
+		void reset() override { primed = false; }
+		const char* name() const override { return "hermite"; }
+
+	private:
+		static const unsigned int MAX_LEVEL = 30;
+
+		bool primed;
+		unsigned int primedLevel;
+		std::vector<std::uint8_t> bins;
+		// Particles per bin
+		std::vector<std::size_t> occupancy;
+		// Tick each particle was last corrected at within the current outer step
+		std::vector<std::uint32_t> lastTick;
+		// Jerk at the last correction, the acceleration lives in particles.ax/ay/az
+		std::vector<float> jx, jy, jz;
+		// Positions and velocities predicted to the current block time, padded like the particle arrays
+		AlignedVector<float> predX, predY, predZ, predVX, predVY, predVZ;
+		// Active particles and their new force and jerk
+		std::vector<std::uint32_t> active;
+		std::vector<float> newA, newJ;
+
+		void prime(ParticleStore& particles, float dt);
+		void predict(const ParticleStore& particles, std::uint32_t tick, float tickLength);
+		// Force and jerk on particle i from the predicted positions and velocities
+		void forceAndJerk(const ParticleStore& particles, std::uint32_t i, float* acc, float* jerk) const;
+		unsigned int binFor(float dt, double wanted) const;
+		unsigned int deepestBin() const;
+};
+
+#endif
@@ -0,0 +1,450 @@
+#include "Ias15Integrator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.h"
+
+// Gauss-Radau spacings
+static const double H[8] = { 0.0, 0.0562625605369221464656521910318, 0.180240691736892364987579942780, 0.352624717113169637373907769648,
+	0.547153626330555383001448554766, 0.734210177215410531523210605558, 0.885320946839095768090359771030, 0.977520613561287501891174488626 };
+// Differences of the spacings, used to build the g coefficients
+static const double RR[28] = { 0.0562625605369221464656522, 0.1802406917368923649875799, 0.1239781311999702185219278, 0.3526247171131696373739078,
+	0.2963621565762474909082556, 0.1723840253762772723863278, 0.5471536263305553830014486, 0.4908910657936332365357964, 0.3669129345936630180138686,
+	0.1945289092173857456275408, 0.7342101772154105315232106, 0.6779476166784883850575584, 0.5539694854785181335356307, 0.3815854601022408611492029,
+	0.1870565508848551155216621, 0.8853209468390957680903598, 0.8290583863021736216247076, 0.7050802551022033830027798, 0.5326962297259261307164520,
+	0.3381673205085403850889112, 0.1511107696236852365671492, 0.9775206135612875018911745, 0.9212580530243653554255223, 0.7972799218243951168035945,
+	0.6248958964481178444063667, 0.4303669872307321063788259, 0.2433104363458769558570639, 0.0922046667057588367499127 };
+// g to b conversion
+static const double C[21] = { -0.0562625605369221464656522, 0.0101408028300636299864818, -0.2365032522738145114532321, -0.0035758977292516175949345,
+	0.0935376952594620658957485, -0.5891279693869841488271399, 0.0019565654099472210769006, -0.0547553868890686864408084, 0.4158812000823068616886219,
+	-1.1362815957175395318285885, -0.0014365302363708915424460, 0.0421585277212687077072973, -0.3600995965020568122897665, 1.2501507118406910258505441,
+	-1.8704917729329500633517991, 0.0012717903090268677492943, -0.0387603579159067703699046, 0.3609622434528459832253398, -1.4668842084004269643701553,
+	2.9061362593084293014237913, -2.7558127197720458314421588 };
+// b to g conversion
+static const double D[21] = { 0.0562625605369221464656522, 0.0031654757181708292499905, 0.2365032522738145114532321, 0.0001780977692217433881125,
+	0.0457929855060279188954539, 0.5891279693869841488271399, 0.0000100202365223291272096, 0.0084318571535257015445000, 0.2535340690545692665214616,
+	1.1362815957175395318285885, 0.0000005637641639318207610, 0.0015297840025004658189490, 0.0978342365324440053653648, 0.8752546646840910912297246,
+	1.8704917729329500633517991, 0.0000000317188154017613665, 0.0002762930909826476593130, 0.0360285539837364596003871, 0.5767330002770787313544596,
+	2.2485887607691597933926895, 2.7558127197720458314421588 };
+
+// A step is redone when the controller wants it this much shorter, and never grows by more than the inverse
+static const double SAFETY_FACTOR = 0.25;
+static const int MAX_ITERATIONS = 12;
+// Coordinates (3 per particle) per chunk of the predictor and corrector sweeps
+static const std::size_t SWEEP_GRAIN = 4096;
+
+// Largest |a| and largest coefficient change over a range of coordinates. Maxima do not depend on the order they are
+// taken in, so the reduction gives the same result for any chunking.
+struct SweepMaxima
+{
+	double acceleration, change;
+};
+
+static SweepMaxima largerOf(const SweepMaxima& a, const SweepMaxima& b)
+{
+	return { std::max(a.acceleration, b.acceleration), std::max(a.change, b.change) };
+}
+
+// Kahan summation so the many small increments to x0 and v0 do not lose bits
+static inline void addCompensated(double& value, double& compensation, double increment)
+{
+	double y = increment - compensation;
+	double t = value + y;
+	compensation = (t - value) - y;
+	value = t;
+}
+
+Ias15Integrator::Ias15Integrator(float softening, SofteningKernel kernel, double epsilon, double minStep, unsigned int maxSteps)
+	: epsilon(epsilon), minStep(minStep), maxSteps(maxSteps), softening(softening), softeningKernel(kernel), acceptedSteps(0),
+	rejectedSteps(0), primed(false), stepTry(0.0), lastStep(0.0)
+{
+}
+
+void Ias15Integrator::prime(const ParticleStore& particles)
+{
+	std::size_t n = particles.size();
+	std::size_t n3 = 3 * n;
+
+	x0.resize(n3);
+	v0.resize(n3);
+	mass.resize(n);
+	massive.clear();
+	for (std::size_t i = 0; i < n; i++)
+	{
+		x0[3 * i] = particles.x[i];
+		x0[3 * i + 1] = particles.y[i];
+		x0[3 * i + 2] = particles.z[i];
+		v0[3 * i] = particles.vx[i];
+		v0[3 * i + 1] = particles.vy[i];
+		v0[3 * i + 2] = particles.vz[i];
+		mass[i] = particles.mass[i];
+		if (mass[i] != 0.0)
+		{
+			massive.push_back((std::uint32_t)i);
+		}
+	}
+
+	a0.assign(n3, 0.0);
+	x.assign(n3, 0.0);
+	a.assign(n3, 0.0);
+	compensationX.assign(n3, 0.0);
+	compensationV.assign(n3, 0.0);
+	b.assign(n3);
+	g.assign(n3);
+	e.assign(n3);
+	previousB.assign(n3);
+	previousE.assign(n3);
+
+	stepTry = 0.0;
+	lastStep = 0.0;
+	primed = true;
+}
+
+void Ias15Integrator::accelerations(const std::vector<double>& positions, std::vector<double>& out)
+{
+	std::size_t n = mass.size();
+	const double eps = softening;
+
+	parallelFor(0, n, 64, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+		{
+			double xi = positions[3 * i], yi = positions[3 * i + 1], zi = positions[3 * i + 2];
+			double accX = 0.0, accY = 0.0, accZ = 0.0;
+			for (std::uint32_t j : massive)
+			{
+				if (j == i)
+				{
+					continue;
+				}
+				double dx = positions[3 * j] - xi;
+				double dy = positions[3 * j + 1] - yi;
+				double dz = positions[3 * j + 2] - zi;
+				double r2 = dx * dx + dy * dy + dz * dz;
+				double s = GRAVITATIONAL_CONSTANT * mass[j] * softenedForceFactor(r2, eps, softeningKernel);
+				accX += dx * s;
+				accY += dy * s;
+				accZ += dz * s;
+			}
+			out[3 * i] = accX;
+			out[3 * i + 1] = accY;
+			out[3 * i + 2] = accZ;
+		}
+	});
+
+	forceEvaluations += n;
+}
+
+void Ias15Integrator::predictNextStep(double ratio)
+{
+	std::size_t n3 = x0.size();
+
+	// Far larger steps make the old coefficients useless as a guess
+	if (ratio > 20.0)
+	{
+		e.assign(n3);
+		b.assign(n3);
+		return;
+	}
+
+	double q1 = ratio;
+	double q2 = q1 * q1;
+	double q3 = q1 * q2;
+	double q4 = q2 * q2;
+	double q5 = q2 * q3;
+	double q6 = q3 * q3;
+	double q7 = q3 * q4;
+
+	for (std::size_t k = 0; k < n3; k++)
+	{
+		const double* pb[7];
+		double correction[7];
+		for (int c = 0; c < 7; c++)
+		{
+			pb[c] = &previousB.p[c][k];
+			correction[c] = previousB.p[c][k] - previousE.p[c][k];
+		}
+
+		e.p[0][k] = q1 * (*pb[6] * 7.0 + *pb[5] * 6.0 + *pb[4] * 5.0 + *pb[3] * 4.0 + *pb[2] * 3.0 + *pb[1] * 2.0 + *pb[0]);
+		e.p[1][k] = q2 * (*pb[6] * 21.0 + *pb[5] * 15.0 + *pb[4] * 10.0 + *pb[3] * 6.0 + *pb[2] * 3.0 + *pb[1]);
+		e.p[2][k] = q3 * (*pb[6] * 35.0 + *pb[5] * 20.0 + *pb[4] * 10.0 + *pb[3] * 4.0 + *pb[2]);
+		e.p[3][k] = q4 * (*pb[6] * 35.0 + *pb[5] * 15.0 + *pb[4] * 5.0 + *pb[3]);
+		e.p[4][k] = q5 * (*pb[6] * 21.0 + *pb[5] * 6.0 + *pb[4]);
+		e.p[5][k] = q6 * (*pb[6] * 7.0 + *pb[5]);
+		e.p[6][k] = q7 * *pb[6];
+
+		for (int c = 0; c < 7; c++)
+		{
+			b.p[c][k] = e.p[c][k] + correction[c];
+		}
+	}
+}
+
+bool Ias15Integrator::tryStep(double h, double floor)
+{
+	std::size_t n3 = x0.size();
+
+	accelerations(x0, a0);
+
+	// g from the predicted b
+	for (std::size_t k = 0; k < n3; k++)
+	{
+		double b0 = b.p[0][k], b1 = b.p[1][k], b2 = b.p[2][k], b3 = b.p[3][k], b4 = b.p[4][k], b5 = b.p[5][k], b6 = b.p[6][k];
+		g.p[0][k] = b6 * D[15] + b5 * D[10] + b4 * D[6] + b3 * D[3] + b2 * D[1] + b1 * D[0] + b0;
+		g.p[1][k] = b6 * D[16] + b5 * D[11] + b4 * D[7] + b3 * D[4] + b2 * D[2] + b1;
+		g.p[2][k] = b6 * D[17] + b5 * D[12] + b4 * D[8] + b3 * D[5] + b2;
+		g.p[3][k] = b6 * D[18] + b5 * D[13] + b4 * D[9] + b3;
+		g.p[4][k] = b6 * D[19] + b5 * D[14] + b4;
+		g.p[5][k] = b6 * D[20] + b5;
+		g.p[6][k] = b6;
+	}
+
+	// Predictor-corrector: stop when the change in the last coefficient is at round-off or has stopped shrinking
+	double correctorError = 1e300, lastCorrectorError = 2.0;
+	for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++)
+	{
+		if (correctorError < 1e-16 || (iteration > 2 && lastCorrectorError <= correctorError))
+		{
+			break;
+		}
+		lastCorrectorError = correctorError;
+		correctorError = 0.0;
+
+		for (int n = 1; n < 8; n++)
+		{
+			double s[9];
+			s[0] = h * H[n];
+			s[1] = s[0] * s[0] / 2.0;
+			s[2] = s[1] * H[n] / 3.0;
+			s[3] = s[2] * H[n] / 2.0;
+			s[4] = 3.0 * s[3] * H[n] / 5.0;
+			s[5] = 2.0 * s[4] * H[n] / 3.0;
+			s[6] = 5.0 * s[5] * H[n] / 7.0;
+			s[7] = 3.0 * s[6] * H[n] / 4.0;
+			s[8] = 7.0 * s[7] * H[n] / 9.0;
+
+			parallelFor(0, n3, SWEEP_GRAIN, [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t k = begin; k < end; k++)
+				{
+					x[k] = -compensationX[k] + ((((((((s[8] * b.p[6][k] + s[7] * b.p[5][k]) + s[6] * b.p[4][k]) + s[5] * b.p[3][k]) + s[4] * b.p[2][k])
+						+ s[3] * b.p[1][k]) + s[2] * b.p[0][k]) + s[1] * a0[k]) + s[0] * v0[k]) + x0[k];
+				}
+			});
+
+			accelerations(x, a);
+
+			SweepMaxima none = {};
+			SweepMaxima largest = parallelReduce(0, n3, SWEEP_GRAIN, none, [&](std::size_t begin, std::size_t end)
+			{
+				SweepMaxima chunk = {};
+				for (std::size_t k = begin; k < end; k++)
+				{
+					double gk = a[k] - a0[k];
+					double previous, change;
+					switch (n)
+					{
+						case 1:
+							previous = g.p[0][k];
+							g.p[0][k] = gk / RR[0];
+							b.p[0][k] += g.p[0][k] - previous;
+							break;
+						case 2:
+							previous = g.p[1][k];
+							g.p[1][k] = (gk / RR[1] - g.p[0][k]) / RR[2];
+							change = g.p[1][k] - previous;
+							b.p[0][k] += change * C[0];
+							b.p[1][k] += change;
+							break;
+						case 3:
+							previous = g.p[2][k];
+							g.p[2][k] = ((gk / RR[3] - g.p[0][k]) / RR[4] - g.p[1][k]) / RR[5];
+							change = g.p[2][k] - previous;
+							b.p[0][k] += change * C[1];
+							b.p[1][k] += change * C[2];
+							b.p[2][k] += change;
+							break;
+						case 4:
+							previous = g.p[3][k];
+							g.p[3][k] = (((gk / RR[6] - g.p[0][k]) / RR[7] - g.p[1][k]) / RR[8] - g.p[2][k]) / RR[9];
+							change = g.p[3][k] - previous;
+							b.p[0][k] += change * C[3];
+							b.p[1][k] += change * C[4];
+							b.p[2][k] += change * C[5];
+							b.p[3][k] += change;
+							break;
+						case 5:
+							previous = g.p[4][k];
+							g.p[4][k] = ((((gk / RR[10] - g.p[0][k]) / RR[11] - g.p[1][k]) / RR[12] - g.p[2][k]) / RR[13] - g.p[3][k]) / RR[14];
+							change = g.p[4][k] - previous;
+							b.p[0][k] += change * C[6];
+							b.p[1][k] += change * C[7];
+							b.p[2][k] += change * C[8];
+							b.p[3][k] += change * C[9];
+							b.p[4][k] += change;
+							break;
+						case 6:
+							previous = g.p[5][k];
+							g.p[5][k] = (((((gk / RR[15] - g.p[0][k]) / RR[16] - g.p[1][k]) / RR[17] - g.p[2][k]) / RR[18] - g.p[3][k]) / RR[19] - g.p[4][k]) / RR[20];
+							change = g.p[5][k] - previous;
+							b.p[0][k] += change * C[10];
+							b.p[1][k] += change * C[11];
+							b.p[2][k] += change * C[12];
+							b.p[3][k] += change * C[13];
+							b.p[4][k] += change * C[14];
+							b.p[5][k] += change;
+							break;
+						default:
+							previous = g.p[6][k];
+							g.p[6][k] = ((((((gk / RR[21] - g.p[0][k]) / RR[22] - g.p[1][k]) / RR[23] - g.p[2][k]) / RR[24] - g.p[3][k]) / RR[25] - g.p[4][k]) / RR[26] - g.p[5][k]) / RR[27];
+							change = g.p[6][k] - previous;
+							b.p[0][k] += change * C[15];
+							b.p[1][k] += change * C[16];
+							b.p[2][k] += change * C[17];
+							b.p[3][k] += change * C[18];
+							b.p[4][k] += change * C[19];
+							b.p[5][k] += change * C[20];
+							b.p[6][k] += change;
+
+							chunk.acceleration = std::max(chunk.acceleration, std::fabs(a[k]));
+							chunk.change = std::max(chunk.change, std::fabs(change));
+							break;
+					}
+				}
+				return chunk;
+			}, largerOf);
+
+			if (n == 7 && largest.acceleration > 0.0)
+			{
+				correctorError = largest.change / largest.acceleration;
+			}
+		}
+	}
+
+	// Step control from the size of the last coefficient relative to the acceleration
+	double maxAcceleration = 0.0, maxB6 = 0.0;
+	for (std::size_t k = 0; k < n3; k++)
+	{
+		maxAcceleration = std::max(maxAcceleration, std::fabs(a[k]));
+		maxB6 = std::max(maxB6, std::fabs(b.p[6][k]));
+	}
+	double error = maxAcceleration > 0.0 ? maxB6 / maxAcceleration : 0.0;
+
+	double next;
+	if (std::isnormal(error))
+	{
+		next = h * std::pow(epsilon / error, 1.0 / 7.0);
+	}
+	else
+	{
+		next = h / SAFETY_FACTOR;
+	}
+	if (std::fabs(next) < floor)
+	{
+		next = std::copysign(floor, next);
+	}
+
+	if (std::fabs(next / h) < SAFETY_FACTOR)
+	{
+		stepTry = next;
+		if (lastStep != 0.0)
+		{
+			predictNextStep(next / lastStep);
+		}
+		else
+		{
+			b.assign(n3);
+		}
+		rejectedSteps++;
+		return false;
+	}
+	if (std::fabs(next / h) > 1.0 / SAFETY_FACTOR)
+	{
+		next = h / SAFETY_FACTOR;
+	}
+
+	// Accept: advance to the end of the step
+	for (std::size_t k = 0; k < n3; k++)
+	{
+		double dx = h * v0[k] + h * h * (a0[k] / 2.0 + b.p[0][k] / 6.0 + b.p[1][k] / 12.0 + b.p[2][k] / 20.0 + b.p[3][k] / 30.0 + b.p[4][k] / 42.0
+			+ b.p[5][k] / 56.0 + b.p[6][k] / 72.0);
+		double dv = h * (a0[k] + b.p[0][k] / 2.0 + b.p[1][k] / 3.0 + b.p[2][k] / 4.0 + b.p[3][k] / 5.0 + b.p[4][k] / 6.0 + b.p[5][k] / 7.0
+			+ b.p[6][k] / 8.0);
+		addCompensated(x0[k], compensationX[k], dx);
+		addCompensated(v0[k], compensationV[k], dv);
+	}
+
+	lastStep = h;
+	acceptedSteps++;
+
+	previousB = b;
+	previousE = e;
+	predictNextStep(next / h);
+	stepTry = next;
+	return true;
+}
+
+void Ias15Integrator::step(ParticleStore& particles, ForceSolver&, float dt)
+{
+	std::size_t n = particles.size();
+	if (n == 0 || dt == 0.0f)
+	{
+		return;
+	}
+
+	if (!primed || mass.size() != n)
+	{
+		prime(particles);
+	}
+	if (stepTry == 0.0 || (stepTry > 0.0) != (dt > 0.0f))
+	{
+		// First guess, corrected by the controller after the first attempt
+		stepTry = dt / 16.0;
+	}
+
+	// Internal steps until the end of the outer step, the last one shortened to land exactly on it. Within the step
+	// budget the floor is whatever covers the rest of the outer step evenly, so the loop ends after maxSteps tries at
+	// the latest, and the last one takes whatever is left.
+	double remaining = dt;
+	unsigned int taken = 0;
+	while (remaining != 0.0)
+	{
+		double floor = std::fabs(dt) * minStep;
+		if (taken + 1 >= maxSteps)
+		{
+			floor = std::fabs(remaining);
+		}
+		else
+		{
+			floor = std::max(floor, std::fabs(remaining) / (maxSteps - taken));
+		}
+		if (std::fabs(stepTry) < floor)
+		{
+			stepTry = std::copysign(floor, remaining);
+		}
+		taken++;
+
+		double h = std::fabs(stepTry) < std::fabs(remaining) ? stepTry : remaining;
+		double tried = stepTry;
+		if (tryStep(h, floor))
+		{
+			remaining -= h;
+			// A shortened final step says nothing new about the step the orbit allows
+			if (h != tried)
+			{
+				stepTry = tried;
+			}
+		}
+	}
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		particles.x[i] = (float)x0[3 * i];
+		particles.y[i] = (float)x0[3 * i + 1];
+		particles.z[i] = (float)x0[3 * i + 2];
+		particles.vx[i] = (float)v0[3 * i];
+		particles.vy[i] = (float)v0[3 * i + 1];
+		particles.vz[i] = (float)v0[3 * i + 2];
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef IAS15_INTEGRATOR_H
+#define IAS15_INTEGRATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Integrator.h"
+#include "Softening.h"
+
+// 15th-order adaptive Gauss-Radau integrator after IAS15 (Rein & Spiegel 2015) for few-body systems. Each step
+// fits the acceleration over the step with a 7th-order polynomial sampled at the Gauss-Radau spacings, iterating the
+// predictor-corrector until the coefficients stop changing, and picks the next step so the last coefficient stays
+// below epsilon relative to the acceleration. An outer step of any size is covered by as many internal steps as that
+// takes, so accuracy no longer depends on the step the caller passes in.
+// State and forces are kept in double for machine precision: forces are a direct sum over the massive particles
+// (massless ones only feel gravity) with the same softening the solvers take, so the simulation's force solver is not
+// used. Close encounters cannot stall it: internal steps have a floor relative to the outer step and their number per
+// outer step is bounded, past which the step is taken less accurately rather than not at all.
+class Ias15Integrator : public Integrator
+{
+	public:
+		// Relative size of the last polynomial coefficient the step controller aims for
+		double epsilon;
+		// Internal steps are never made shorter than this fraction of the outer step
+		double minStep;
+		// Internal steps, accepted and rejected, allowed per outer step. Once they run low the floor is raised so the
+		// rest of the outer step is covered in the steps that are left.
+		unsigned int maxSteps;
+		float softening;
+		SofteningKernel softeningKernel;
+
+		explicit Ias15Integrator(float softening = 0.0f, SofteningKernel kernel = SOFTENING_PLUMMER, double epsilon = 1e-9,
+			double minStep = 1e-9, unsigned int maxSteps = 4096);
+
+		void step(ParticleStore& particles, ForceSolver& solver, float dt) override;
+		void reset() override { primed = false; }
+		const char* name() const override { return "ias15"; }
+
+		// Internal steps taken so far, accepted and rejected
+		std::uint64_t acceptedSteps, rejectedSteps;
+
+	private:
+		// Seven coefficient sets, each holding three components per particle
+		struct Coefficients
+		{
+			std::vector<double> p[7];
+
+			void assign(std::size_t size) { for (int k = 0; k < 7; k++) p[k].assign(size, 0.0); }
+		};
+
+		bool primed;
+		// Step to try next and the last step that was accepted
+		double stepTry, lastStep;
+		// Positions, velocities and accelerations as x0, y0, z0, x1, ..., with compensated-summation error terms
+		std::vector<double> x0, v0, a0, compensationX, compensationV;
+		// Predicted positions and accelerations at the current substep
+		std::vector<double> x, a;
+		std::vector<double> mass;
+		std::vector<std::uint32_t> massive;
+		Coefficients b, g, e, previousB, previousE;
+
+		void prime(const ParticleStore& particles);
+		void accelerations(const std::vector<double>& positions, std::vector<double>& out);
+		// Tries one step of length h, returns false (and sets stepTry) if the step was rejected. The controller never
+		// asks for a step shorter than floor, so a step of that length is always accepted.
+		bool tryStep(double h, double floor);
+		// Extrapolates the converged coefficients to a step ratio times as long to start the next iteration close
+		void predictNextStep(double ratio);
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <cstdint>
+
+#include "ForceSolver.h"
+#include "ParticleStore.h"
+
+// Common interface for the time-stepping schemes. An integrator asks the force solver for accelerations as often
+// as it needs and advances positions and velocities by one outer step.
+class Integrator
+{
+	public:
+		// Particle accelerations requested so far, one per particle per force evaluation
+		std::uint64_t forceEvaluations;
+
+		Integrator() : forceEvaluations(0) {}
+		virtual ~Integrator() {}
+
+		virtual void step(ParticleStore& particles, ForceSolver& solver, float dt) = 0;
+
+		// Drops anything carried over between steps (cached accelerations, time bins). Needed whenever particles are
+		// added, removed or moved outside the integrator, or the force solver changes.
+		virtual void reset() {}
+
+		// Called after the particles were moved between indices by ParticleStore::permute. Integrators whose only
+		// carried state is in the store (which permute moves along) keep it, the rest drop their state as in reset().
+		virtual void particlesReordered() { reset(); }
+
+		// Short identifier used by the headless driver
+		virtual const char* name() const = 0;
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "Kepler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.h"
+
+static const int MAX_QUARTERINGS = 40;
+static const int MAX_ITERATIONS = 50;
+static const double PI = 3.14159265358979323846;
+
+// Orbits per parallelFor chunk
+static const std::size_t KEPLER_GRAIN = 64 * KEPLER_LANES;
+
+// One value per lane
+typedef double Lanes[KEPLER_LANES];
+
+// Stumpff functions c0..c3 of z = beta * X^2 multiplied out to the G-functions G_n = X^n c_n(z).
+// The series is only accurate for small |z|, so z is divided by 4 until |z| < 0.1 and the result scaled back up with
+// c0(4z) = 2 c0^2 - 1, c1(4z) = c0 c1, c2(4z) = c1^2 / 2, c3(4z) = (c2 + c0 c3) / 4.
+static inline void gFunctions(const Lanes& beta, const Lanes& X, Lanes& g0, Lanes& g1, Lanes& g2, Lanes& g3)
+{
+	Lanes zs, c0, c1, c2, c3;
+	int quarterings[KEPLER_LANES];
+	int deepest = 0;
+
+	for (std::size_t l = 0; l < KEPLER_LANES; l++)
+	{
+		zs[l] = beta[l] * X[l] * X[l];
+		quarterings[l] = 0;
+	}
+	for (int q = 0; q < MAX_QUARTERINGS; q++)
+	{
+		bool any = false;
+		for (std::size_t l = 0; l < KEPLER_LANES; l++)
+		{
+			bool large = std::fabs(zs[l]) > 0.1;
+			zs[l] = large ? zs[l] * 0.25 : zs[l];
+			quarterings[l] += large ? 1 : 0;
+			any |= large;
+		}
+		if (!any)
+		{
+			break;
+		}
+		deepest = q + 1;
+	}
+
+	for (std::size_t l = 0; l < KEPLER_LANES; l++)
+	{
+		// c2 = sum (-z)^k / (2k + 2)!, c3 = sum (-z)^k / (2k + 3)!
+		double v = zs[l];
+		c2[l] = 1.0 / 2 - v * (1.0 / 24 - v * (1.0 / 720 - v * (1.0 / 40320 - v * (1.0 / 3628800 - v * (1.0 / 479001600 - v / 87178291200.0)))));
+		c3[l] = 1.0 / 6 - v * (1.0 / 120 - v * (1.0 / 5040 - v * (1.0 / 362880 - v * (1.0 / 39916800 - v * (1.0 / 6227020800.0 - v / 1307674368000.0)))));
+		c0[l] = 1.0 - v * c2[l];
+		c1[l] = 1.0 - v * c3[l];
+	}
+
+	for (int q = 0; q < deepest; q++)
+	{
+		for (std::size_t l = 0; l < KEPLER_LANES; l++)
+		{
+			bool scale = q < quarterings[l];
+			double n0 = 2.0 * c0[l] * c0[l] - 1.0;
+			double n1 = c0[l] * c1[l];
+			double n2 = 0.5 * c1[l] * c1[l];
+			double n3 = 0.25 * (c2[l] + c0[l] * c3[l]);
+			c0[l] = scale ? n0 : c0[l];
+			c1[l] = scale ? n1 : c1[l];
+			c2[l] = scale ? n2 : c2[l];
+			c3[l] = scale ? n3 : c3[l];
+		}
+	}
+
+	for (std::size_t l = 0; l < KEPLER_LANES; l++)
+	{
+		double x2 = X[l] * X[l];
+		g0[l] = c0[l];
+		g1[l] = X[l] * c1[l];
+		g2[l] = x2 * c2[l];
+		g3[l] = x2 * X[l] * c3[l];
+	}
+}
+
+// Sine and cosine of every lane: x = k pi/2 + r with pi/2 split in three parts so r is exact, then the fdlibm
+// minimax polynomials on [-pi/4, pi/4] and a swap/negate by quadrant. Selects instead of branches keep it vectorisable.
+static inline void sinCos(const Lanes& angle, Lanes& sine, Lanes& cosine)
+{
+	const double PIO2_1 = 1.57079632673412561417e+00;
+	const double PIO2_2 = 6.07710050630396597660e-11;
+	const double PIO2_3 = 2.02226624871116645580e-21;
+
+	for (std::size_t l = 0; l < KEPLER_LANES; l++)
+	{
+		double k = std::nearbyint(angle[l] * (2.0 / PI));
+		double r = ((angle[l] - k * PIO2_1) - k * PIO2_2) - k * PIO2_3;
+		double z = r * r;
+
+		double s = r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04
+			+ z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+		double c = 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * (2.48015872894767294178e-05
+			+ z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+
+		long long quadrant = (long long)k & 3;
+		double swappedS = (quadrant & 1) ? c : s;
+		double swappedC = (quadrant & 1) ? s : c;
+		sine[l] = (quadrant & 2) ? -swappedS : swappedS;
+		cosine[l] = ((quadrant + 1) & 2) ? -swappedC : swappedC;
+	}
+}
+
+// Solves one batch in place. Lanes past count are filled with a copy of lane 0 and discarded.
+static void solveBatch(double* x, double* y, double* z, double* vx, double* vy, double* vz, std::size_t count, double mu, double dt)
+{
+	Lanes px, py, pz, qx, qy, qz, r0, eta0, zeta0, beta, h, X;
+	bool straight[KEPLER_LANES];
+
+	for (std::size_t l = 0; l < KEPLER_LANES; l++)
+	{
+		std::size_t k = l < count ? l : 0;
+		px[l] = x[k];
+		py[l] = y[k];
+		pz[l] = z[k];
+		qx[l] = vx[k];
+		qy[l] = vy[k];
+		qz[l] = vz[k];
+
+		r0[l] = std::sqrt(px[l] * px[l] + py[l] * py[l] + pz[l] * pz[l]);
+		straight[l] = r0[l] == 0.0;
+		if (straight[l])
+		{
+			// Stand-in orbit so the lane stays finite, the particle itself drifts in a straight line below
+			px[l] = r0[l] = 1.0;
+			py[l] = pz[l] = qx[l] = qz[l] = 0.0;
+			qy[l] = std::sqrt(mu);
+		}
+
+		double v2 = qx[l] * qx[l] + qy[l] * qy[l] + qz[l] * qz[l];
+		eta0[l] = px[l] * qx[l] + py[l] * qy[l] + pz[l] * qz[l];
+		beta[l] = 2.0 * mu / r0[l] - v2;
+		zeta0[l] = mu - beta[l] * r0[l];
+
+		// Whole periods of bound orbits change nothing, so only the remainder is solved for
+		h[l] = dt;
+		if (beta[l] > 0.0)
+		{
+			double period = 2.0 * PI * mu / (beta[l] * std::sqrt(beta[l]));
+			h[l] = std::fmod(dt, period);
+		}
+
+		// dt / r0 is close for short steps, the mean motion guess beta dt / mu is better past a fraction of an orbit
+		X[l] = h[l] / r0[l];
+		if (beta[l] > 0.0 && std::fabs(X[l] * std::sqrt(beta[l])) > 1.0)
+		{
+			X[l] = beta[l] * h[l] / mu;
+		}
+	}
+
+	Lanes g0, g1, g2, g3;
+	for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++)
+	{
+		gFunctions(beta, X, g0, g1, g2, g3);
+
+		// Laguerre-Conway step on f(X) = r0 G1 + eta0 G2 + mu G3 - dt, whose derivative is the radius. Converges from
+		// almost any starting guess, unlike Newton or Halley on very eccentric orbits.
+		bool converged = true;
+		for (std::size_t l = 0; l < KEPLER_LANES; l++)
+		{
+			double f = r0[l] * g1[l] + eta0[l] * g2[l] + mu * g3[l] - h[l];
+			double fp = r0[l] * g0[l] + eta0[l] * g1[l] + mu * g2[l];
+			double fpp = eta0[l] * g0[l] + zeta0[l] * g1[l];
+			double root = std::sqrt(std::fabs(16.0 * fp * fp - 20.0 * f * fpp));
+			double dX = -5.0 * f / (fp + (fp < 0.0 ? -root : root));
+			X[l] += dX;
+			converged &= std::fabs(dX) <= 1e-15 * std::fabs(X[l]) || dX == 0.0;
+		}
+		if (converged)
+		{
+			break;
+		}
+	}
+	gFunctions(beta, X, g0, g1, g2, g3);
+
+	for (std::size_t l = 0; l < count; l++)
+	{
+		if (straight[l])
+		{
+			x[l] += vx[l] * dt;
+			y[l] += vy[l] * dt;
+			z[l] += vz[l] * dt;
+			continue;
+		}
+
+		// Lagrange f and g coefficients
+		double r = r0[l] * g0[l] + eta0[l] * g1[l] + mu * g2[l];
+		double f = 1.0 - mu * g2[l] / r0[l];
+		double g = h[l] - mu * g3[l];
+		double fd = -mu * g1[l] / (r * r0[l]);
+		double gd = 1.0 - mu * g2[l] / r;
+
+		x[l] = f * px[l] + g * qx[l];
+		y[l] = f * py[l] + g * qy[l];
+		z[l] = f * pz[l] + g * qz[l];
+		vx[l] = fd * px[l] + gd * qx[l];
+		vy[l] = fd * py[l] + gd * qy[l];
+		vz[l] = fd * pz[l] + gd * qz[l];
+	}
+}
+
+void keplerDrift(double* x, double* y, double* z, double* vx, double* vy, double* vz, std::size_t count, double mu, double dt)
+{
+	if (mu <= 0.0)
+	{
+		for (std::size_t i = 0; i < count; i++)
+		{
+			x[i] += vx[i] * dt;
+			y[i] += vy[i] * dt;
+			z[i] += vz[i] * dt;
+		}
+		return;
+	}
+
+	parallelFor(0, count, KEPLER_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t b = begin; b < end; b += KEPLER_LANES)
+		{
+			std::size_t lanes = std::min(KEPLER_LANES, end - b);
+			solveBatch(x + b, y + b, z + b, vx + b, vy + b, vz + b, lanes, mu, dt);
+		}
+	});
+}
+
+static void solveKeplerBatch(const double* meanAnomaly, const double* eccentricity, double* sinE, double* cosE, std::size_t count)
+{
+	Lanes M, e, E, s, c;
+
+	for (std::size_t l = 0; l < KEPLER_LANES; l++)
+	{
+		std::size_t k = l < count ? l : 0;
+		// Mean anomaly into [-pi, pi]
+		M[l] = meanAnomaly[k] - 2.0 * PI * std::nearbyint(meanAnomaly[k] * (0.5 / PI));
+		e[l] = eccentricity[k];
+		E[l] = M[l] + (M[l] < 0.0 ? -0.85 : 0.85) * e[l];
+	}
+
+	for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++)
+	{
+		sinCos(E, s, c);
+
+		bool converged = true;
+		for (std::size_t l = 0; l < KEPLER_LANES; l++)
+		{
+			double f = E[l] - e[l] * s[l] - M[l];
+			double dE = -f / (1.0 - e[l] * c[l]);
+			E[l] += dE;
+			converged &= std::fabs(dE) <= 1e-14;
+		}
+		if (converged)
+		{
+			break;
+		}
+	}
+	sinCos(E, s, c);
+
+	for (std::size_t l = 0; l < count; l++)
+	{
+		sinE[l] = s[l];
+		cosE[l] = c[l];
+	}
+}
+
+void solveKeplerEquation(const double* meanAnomaly, const double* eccentricity, double* sinE, double* cosE, std::size_t count)
+{
+	parallelFor(0, count, KEPLER_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t b = begin; b < end; b += KEPLER_LANES)
+		{
+			std::size_t lanes = std::min(KEPLER_LANES, end - b);
+			solveKeplerBatch(meanAnomaly + b, eccentricity + b, sinE + b, cosE + b, lanes);
+		}
+	});
+}
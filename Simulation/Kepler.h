@@ -0,0 +1,21 @@
+#ifndef KEPLER_H
+#define KEPLER_H
+
+#include <cstddef>
+
+// Number of orbits solved together, one AVX-512 register (two AVX2 registers) of doubles
+const std::size_t KEPLER_LANES = 8;
+
+// Advances count two-body orbits around a fixed centre at the origin with strength mu = G * M by dt, in place.
+// Uses universal variables so elliptic, parabolic and hyperbolic orbits share one code path. Orbits are solved
+// KEPLER_LANES at a time with branch-free loops over the lanes (Stumpff series with argument quartering, Laguerre-Conway
+// iterations until every lane converges) which the compiler turns into SIMD. Particles at the centre drift in a
+// straight line.
+void keplerDrift(double* x, double* y, double* z, double* vx, double* vy, double* vz, std::size_t count, double mu, double dt);
+
+// Solves Kepler's equation M = E - e sin E for elliptic orbits (0 <= e < 1) and returns sin E and cos E.
+// meanAnomaly may be any angle. Works KEPLER_LANES orbits at a time like keplerDrift, using Newton iterations from
+// Danby's starting guess and a lane-wise sine/cosine so the whole solve stays in SIMD registers.
+void solveKeplerEquation(const double* meanAnomaly, const double* eccentricity, double* sinE, double* cosE, std::size_t count);
+
+#endif
@@ -0,0 +1,195 @@
+#include "KeplerPropagator.h"
+
+#include <cmath>
+
+#include "Kepler.h"
+#include "Parallel.h"
+
+// Orbits this close to parabolic or radial are left to the universal-variable solver
+static const double MAX_ECCENTRICITY = 0.999;
+
+void KeplerPropagator::capture(const ParticleStore& particles)
+{
+	std::size_t n = particles.size();
+
+	mu = GRAVITATIONAL_CONSTANT * (double)particles.mass[0];
+	sunX = particles.x[0];
+	sunY = particles.y[0];
+	sunZ = particles.z[0];
+	sunVX = particles.vx[0];
+	sunVY = particles.vy[0];
+	sunVZ = particles.vz[0];
+
+	ellipticIndex.clear();
+	semiMajor.clear();
+	semiMinor.clear();
+	eccentricity.clear();
+	meanMotion.clear();
+	meanAnomaly.clear();
+	px.clear();
+	py.clear();
+	pz.clear();
+	qx.clear();
+	qy.clear();
+	qz.clear();
+	otherIndex.clear();
+	otherX.clear();
+	otherY.clear();
+	otherZ.clear();
+	otherVX.clear();
+	otherVY.clear();
+	otherVZ.clear();
+
+	for (std::uint32_t i = 1; i < n; i++)
+	{
+		double rx = (double)particles.x[i] - sunX, ry = (double)particles.y[i] - sunY, rz = (double)particles.z[i] - sunZ;
+		double vx = (double)particles.vx[i] - sunVX, vy = (double)particles.vy[i] - sunVY, vz = (double)particles.vz[i] - sunVZ;
+
+		double r = std::sqrt(rx * rx + ry * ry + rz * rz);
+		double v2 = vx * vx + vy * vy + vz * vz;
+		double hx = ry * vz - rz * vy, hy = rz * vx - rx * vz, hz = rx * vy - ry * vx;
+		double h = std::sqrt(hx * hx + hy * hy + hz * hz);
+		double energy = 0.5 * v2 - (r > 0.0 ? mu / r : 0.0);
+
+		// Eccentricity vector (v x h) / mu - r / |r|
+		double ex = 0.0, ey = 0.0, ez = 0.0, e = 1.0;
+		if (mu > 0.0 && r > 0.0)
+		{
+			ex = (vy * hz - vz * hy) / mu - rx / r;
+			ey = (vz * hx - vx * hz) / mu - ry / r;
+			ez = (vx * hy - vy * hx) / mu - rz / r;
+			e = std::sqrt(ex * ex + ey * ey + ez * ez);
+		}
+
+		if (mu <= 0.0 || r == 0.0 || h == 0.0 || energy >= 0.0 || e >= MAX_ECCENTRICITY)
+		{
+			otherIndex.push_back(i);
+			otherX.push_back(rx);
+			otherY.push_back(ry);
+			otherZ.push_back(rz);
+			otherVX.push_back(vx);
+			otherVY.push_back(vy);
+			otherVZ.push_back(vz);
+			continue;
+		}
+
+		double a = -mu / (2.0 * energy);
+
+		// P towards pericentre, or along r for circular orbits where it is undefined. Q = h x P / |h|.
+		double ux, uy, uz;
+		if (e > 1e-12)
+		{
+			ux = ex / e;
+			uy = ey / e;
+			uz = ez / e;
+		}
+		else
+		{
+			ux = rx / r;
+			uy = ry / r;
+			uz = rz / r;
+		}
+		double wx = (hy * uz - hz * uy) / h, wy = (hz * ux - hx * uz) / h, wz = (hx * uy - hy * ux) / h;
+
+		double b = a * std::sqrt(1.0 - e * e);
+		double E = std::atan2((rx * wx + ry * wy + rz * wz) / b, (rx * ux + ry * uy + rz * uz) / a + e);
+
+		ellipticIndex.push_back(i);
+		semiMajor.push_back(a);
+		semiMinor.push_back(b);
+		eccentricity.push_back(e);
+		meanMotion.push_back(std::sqrt(mu / (a * a * a)));
+		meanAnomaly.push_back(E - e * std::sin(E));
+		px.push_back(ux);
+		py.push_back(uy);
+		pz.push_back(uz);
+		qx.push_back(wx);
+		qy.push_back(wy);
+		qz.push_back(wz);
+	}
+
+	elapsed = 0.0;
+	captured = true;
+}
+
+void KeplerPropagator::seek(ParticleStore& particles, double time)
+{
+	if (particles.empty())
+	{
+		return;
+	}
+	if (!captured || ellipticIndex.size() + otherIndex.size() != particles.size() - 1)
+	{
+		capture(particles);
+	}
+
+	elapsed = time;
+
+	double centerX = sunX + sunVX * time, centerY = sunY + sunVY * time, centerZ = sunZ + sunVZ * time;
+	particles.x[0] = (float)centerX;
+	particles.y[0] = (float)centerY;
+	particles.z[0] = (float)centerZ;
+
+	std::size_t elliptic = ellipticIndex.size();
+	anomaly.resize(elliptic);
+	sinE.resize(elliptic);
+	cosE.resize(elliptic);
+	for (std::size_t k = 0; k < elliptic; k++)
+	{
+		anomaly[k] = meanAnomaly[k] + meanMotion[k] * time;
+	}
+
+	solveKeplerEquation(anomaly.data(), eccentricity.data(), sinE.data(), cosE.data(), elliptic);
+
+	parallelFor(0, elliptic, 4096, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t k = begin; k < end; k++)
+		{
+			// Position a (cos E - e) P + b sin E Q, velocity dE/dt (-a sin E P + b cos E Q)
+			double along = semiMajor[k] * (cosE[k] - eccentricity[k]);
+			double across = semiMinor[k] * sinE[k];
+			double rate = meanMotion[k] / (1.0 - eccentricity[k] * cosE[k]);
+			double alongV = -rate * semiMajor[k] * sinE[k];
+			double acrossV = rate * semiMinor[k] * cosE[k];
+
+			std::uint32_t i = ellipticIndex[k];
+			particles.x[i] = (float)(centerX + along * px[k] + across * qx[k]);
+			particles.y[i] = (float)(centerY + along * py[k] + across * qy[k]);
+			particles.z[i] = (float)(centerZ + along * pz[k] + across * qz[k]);
+			particles.vx[i] = (float)(sunVX + alongV * px[k] + acrossV * qx[k]);
+			particles.vy[i] = (float)(sunVY + alongV * py[k] + acrossV * qy[k]);
+			particles.vz[i] = (float)(sunVZ + alongV * pz[k] + acrossV * qz[k]);
+		}
+	});
+
+	if (!otherIndex.empty())
+	{
+		driftX = otherX;
+		driftY = otherY;
+		driftZ = otherZ;
+		driftVX = otherVX;
+		driftVY = otherVY;
+		driftVZ = otherVZ;
+		keplerDrift(driftX.data(), driftY.data(), driftZ.data(), driftVX.data(), driftVY.data(), driftVZ.data(), driftX.size(), mu, time);
+
+		for (std::size_t k = 0; k < otherIndex.size(); k++)
+		{
+			std::uint32_t i = otherIndex[k];
+			particles.x[i] = (float)(centerX + driftX[k]);
+			particles.y[i] = (float)(centerY + driftY[k]);
+			particles.z[i] = (float)(centerZ + driftZ[k]);
+			particles.vx[i] = (float)(sunVX + driftVX[k]);
+			particles.vy[i] = (float)(sunVY + driftVY[k]);
+			particles.vz[i] = (float)(sunVZ + driftVZ[k]);
+		}
+	}
+}
+
+void KeplerPropagator::step(ParticleStore& particles, ForceSolver&, float dt)
+{
+	if (!captured)
+	{
+		capture(particles);
+	}
+	seek(particles, elapsed + dt);
+}
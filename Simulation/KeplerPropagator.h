@@ -0,0 +1,51 @@
+#ifndef KEPLER_PROPAGATOR_H
+#define KEPLER_PROPAGATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Integrator.h"
+
+// Analytic propagation for the sun-only model (CentralGravity): the sun drifts at its own velocity and every other
+// particle follows a fixed Kepler orbit around it. The first step converts each particle to orbital elements, after
+// which any time is reached in O(1) per particle by solving Kepler's equation (solveKeplerEquation), so seek() can
+// fast-forward or scrub backwards without stepping. Unbound, radial and degenerate orbits keep their starting state
+// and go through the universal-variable keplerDrift instead. The force solver is ignored.
+class KeplerPropagator : public Integrator
+{
+	public:
+		KeplerPropagator() : captured(false), elapsed(0.0) {}
+
+		void step(ParticleStore& particles, ForceSolver& solver, float dt) override;
+		void reset() override { captured = false; }
+		const char* name() const override { return "kepler"; }
+
+		// Moves every particle to the given time since the orbits were captured (the first step or seek)
+		void seek(ParticleStore& particles, double time);
+		double time() const { return elapsed; }
+
+	private:
+		bool captured;
+		double elapsed;
+		double mu;
+		// Sun state at capture time
+		double sunX, sunY, sunZ, sunVX, sunVY, sunVZ;
+
+		// Elliptic orbits: particle index, semi-major axis a, semi-minor axis b, eccentricity, mean motion, mean anomaly at
+		// capture, and the unit vectors P (towards pericentre) and Q in the orbit plane
+		std::vector<std::uint32_t> ellipticIndex;
+		std::vector<double> semiMajor, semiMinor, eccentricity, meanMotion, meanAnomaly;
+		std::vector<double> px, py, pz, qx, qy, qz;
+
+		// Everything else: particle index and heliocentric state at capture
+		std::vector<std::uint32_t> otherIndex;
+		std::vector<double> otherX, otherY, otherZ, otherVX, otherVY, otherVZ;
+
+		// Scratch for seek()
+		std::vector<double> anomaly, sinE, cosE;
+		std::vector<double> driftX, driftY, driftZ, driftVX, driftVY, driftVZ;
+
+		void capture(const ParticleStore& particles);
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "KustaanheimoStiefel.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+static const unsigned int MAX_STEPS = 1000000;
+static const int MAX_LANDING_ITERATIONS = 8;
+
+// u[4], u'[4], energy h = v^2 / 2 - mu / r, physical time t
+struct KsState
+{
+	double u[4];
+	double w[4];
+	double energy;
+	double time;
+};
+
+// Derivatives with respect to s: u' = w, w' = (h / 2) u + (r / 2) L^T(u) P, h' = 2 w . L^T(u) P, t' = r
+static inline void derivatives(const KsState& y, const double* p, KsState& dy)
+{
+	const double* u = y.u;
+	double r = u[0] * u[0] + u[1] * u[1] + u[2] * u[2] + u[3] * u[3];
+
+	double q[4];
+	q[0] = u[0] * p[0] + u[1] * p[1] + u[2] * p[2];
+	q[1] = -u[1] * p[0] + u[0] * p[1] + u[3] * p[2];
+	q[2] = -u[2] * p[0] - u[3] * p[1] + u[0] * p[2];
+	q[3] = u[3] * p[0] - u[2] * p[1] + u[1] * p[2];
+
+	double work = 0.0;
+	for (int k = 0; k < 4; k++)
+	{
+		dy.u[k] = y.w[k];
+		dy.w[k] = 0.5 * y.energy * u[k] + 0.5 * r * q[k];
+		work += y.w[k] * q[k];
+	}
+	dy.energy = 2.0 * work;
+	dy.time = r;
+}
+
+// y + scale * dy
+static inline KsState advance(const KsState& y, const KsState& dy, double scale)
+{
+	KsState out;
+	for (int k = 0; k < 4; k++)
+	{
+		out.u[k] = y.u[k] + scale * dy.u[k];
+		out.w[k] = y.w[k] + scale * dy.w[k];
+	}
+	out.energy = y.energy + scale * dy.energy;
+	out.time = y.time + scale * dy.time;
+	return out;
+}
+
+static KsState rungeKutta(const KsState& y, const double* p, double ds)
+{
+	KsState k1, k2, k3, k4;
+	derivatives(y, p, k1);
+	derivatives(advance(y, k1, 0.5 * ds), p, k2);
+	derivatives(advance(y, k2, 0.5 * ds), p, k3);
+	derivatives(advance(y, k3, ds), p, k4);
+
+	KsState out;
+	for (int k = 0; k < 4; k++)
+	{
+		out.u[k] = y.u[k] + ds / 6.0 * (k1.u[k] + 2.0 * k2.u[k] + 2.0 * k3.u[k] + k4.u[k]);
+		out.w[k] = y.w[k] + ds / 6.0 * (k1.w[k] + 2.0 * k2.w[k] + 2.0 * k3.w[k] + k4.w[k]);
+	}
+	out.energy = y.energy + ds / 6.0 * (k1.energy + 2.0 * k2.energy + 2.0 * k3.energy + k4.energy);
+	out.time = y.time + ds / 6.0 * (k1.time + 2.0 * k2.time + 2.0 * k3.time + k4.time);
+	return out;
+}
+
+static inline double radius(const KsState& y)
+{
+	return y.u[0] * y.u[0] + y.u[1] * y.u[1] + y.u[2] * y.u[2] + y.u[3] * y.u[3];
+}
+
+unsigned int ksPropagate(double position[3], double velocity[3], double mu, const double perturbation[3], double dt, unsigned int stepsPerOrbit)
+{
+	double x = position[0], y = position[1], z = position[2];
+	double r = std::sqrt(x * x + y * y + z * z);
+	if (r == 0.0 || dt == 0.0)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			position[k] += velocity[k] * dt + 0.5 * perturbation[k] * dt * dt;
+			velocity[k] += perturbation[k] * dt;
+		}
+		return 0;
+	}
+
+	// u from x, choosing the branch that avoids dividing by a small component
+	KsState state;
+	if (x >= 0.0)
+	{
+		state.u[0] = std::sqrt(0.5 * (r + x));
+		state.u[1] = y / (2.0 * state.u[0]);
+		state.u[2] = z / (2.0 * state.u[0]);
+		state.u[3] = 0.0;
+	}
+	else
+	{
+		state.u[1] = std::sqrt(0.5 * (r - x));
+		state.u[0] = y / (2.0 * state.u[1]);
+		state.u[3] = z / (2.0 * state.u[1]);
+		state.u[2] = 0.0;
+	}
+
+	// w = L^T(u) v / 2
+	const double* u = state.u;
+	const double* v = velocity;
+	state.w[0] = 0.5 * (u[0] * v[0] + u[1] * v[1] + u[2] * v[2]);
+	state.w[1] = 0.5 * (-u[1] * v[0] + u[0] * v[1] + u[3] * v[2]);
+	state.w[2] = 0.5 * (-u[2] * v[0] - u[3] * v[1] + u[0] * v[2]);
+	state.w[3] = 0.5 * (u[3] * v[0] - u[2] * v[1] + u[1] * v[2]);
+	state.energy = 0.5 * (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]) - mu / r;
+	state.time = 0.0;
+
+	// Backwards steps run the same equations with negative s
+	double direction = dt > 0.0 ? 1.0 : -1.0;
+	double target = std::fabs(dt);
+
+	unsigned int steps = 0;
+	while (steps < MAX_STEPS)
+	{
+		// u oscillates with frequency sqrt(-h / 2) for a bound orbit, and x goes round once per half period of u.
+		// mu / r takes over near the centre and on open orbits so the step still resolves the pericentre passage.
+		double rs = radius(state);
+		double frequency = std::sqrt(0.5 * (std::fabs(state.energy) + mu / rs));
+		double ds = PI / (frequency * stepsPerOrbit);
+
+		KsState next = rungeKutta(state, perturbation, direction * ds);
+		steps++;
+		if (direction * next.time < target)
+		{
+			state = next;
+			continue;
+		}
+
+		// Final step: Newton on t(s) = target with t' = r, restarting from the same state each time
+		double remaining = target - direction * state.time;
+		ds = remaining / rs;
+		for (int iteration = 0; iteration < MAX_LANDING_ITERATIONS; iteration++)
+		{
+			next = rungeKutta(state, perturbation, direction * ds);
+			steps++;
+			double miss = target - direction * next.time;
+			if (std::fabs(miss) <= 1e-14 * target)
+			{
+				break;
+			}
+			ds += miss / std::max(radius(next), 1e-300);
+		}
+		state = next;
+		break;
+	}
+
+	// x = L(u) u and v = 2 L(u) w / r
+	u = state.u;
+	const double* w = state.w;
+	double rEnd = radius(state);
+	position[0] = u[0] * u[0] - u[1] * u[1] - u[2] * u[2] + u[3] * u[3];
+	position[1] = 2.0 * (u[0] * u[1] - u[2] * u[3]);
+	position[2] = 2.0 * (u[0] * u[2] + u[1] * u[3]);
+	velocity[0] = 2.0 / rEnd * (u[0] * w[0] - u[1] * w[1] - u[2] * w[2] + u[3] * w[3]);
+	velocity[1] = 2.0 / rEnd * (u[1] * w[0] + u[0] * w[1] - u[3] * w[2] - u[2] * w[3]);
+	velocity[2] = 2.0 / rEnd * (u[2] * w[0] + u[3] * w[1] + u[0] * w[2] + u[1] * w[3]);
+
+	return steps;
+}
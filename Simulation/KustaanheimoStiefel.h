@@ -0,0 +1,14 @@
+#ifndef KUSTAANHEIMO_STIEFEL_H
+#define KUSTAANHEIMO_STIEFEL_H
+
+// Advances the relative orbit of a particle about a centre of strength mu = G * M by dt, in place, in
+// Kustaanheimo-Stiefel coordinates. The 3D position is written as x = L(u) u for a 4D vector u and time is stretched
+// by dt = r ds, which turns the Kepler problem into a harmonic oscillator in u with no singularity at r = 0. The
+// constant perturbing acceleration (the pull of everything except the centre) is carried inside the regularised
+// equations, so a close or even head-on pass is integrated smoothly instead of through a huge kick.
+// Uses classical Runge-Kutta in the fictitious time s with about stepsPerOrbit steps per revolution, and lands on dt
+// exactly by Newton iteration on the last step. Returns the number of regularised steps taken (0 if the particle sits
+// on the centre, where it drifts in a straight line).
+unsigned int ksPropagate(double position[3], double velocity[3], double mu, const double perturbation[3], double dt, unsigned int stepsPerOrbit = 256);
+
+#endif
@@ -0,0 +1,82 @@
+#include "MassiveBodyGravity.h"
+
+#include <algorithm>
+
+#include "GravityKernel.h"
+#include "Parallel.h"
+
+void MassiveBodyGravity::gatherBodies(const ParticleStore& particles)
+{
+	bodyX.clear();
+	bodyY.clear();
+	bodyZ.clear();
+	bodyMass.clear();
+
+	for (std::size_t i = 0; i < particles.size(); i++)
+	{
+		if (particles.mass[i] > massThreshold)
+		{
+			bodyX.push_back(particles.x[i]);
+			bodyY.push_back(particles.y[i]);
+			bodyZ.push_back(particles.z[i]);
+			bodyMass.push_back(particles.mass[i]);
+		}
+	}
+}
+
+// Pull of the bodies on particle i through the per-particle kernel, which also handles the spline
+static inline void bodyPull(const ParticleStore& particles, std::size_t i, const AlignedVector<float>& bodyX, const AlignedVector<float>& bodyY,
+	const AlignedVector<float>& bodyZ, const AlignedVector<float>& bodyMass, float softening, SofteningKernel kernel, float& accX, float& accY, float& accZ)
+{
+	accX = accY = accZ = 0.0f;
+	accumulateSoftenedGravity(bodyX.data(), bodyY.data(), bodyZ.data(), bodyMass.data(), bodyMass.size(),
+		particles.x[i], particles.y[i], particles.z[i], softening, kernel, accX, accY, accZ);
+}
+
+void MassiveBodyGravity::computeAccelerations(ParticleStore& particles)
+{
+	gatherBodies(particles);
+
+	std::size_t n = particles.size();
+	std::size_t bodies = bodyMass.size();
+	bool spline = kernel == SOFTENING_SPLINE && softening > 0.0f;
+
+	parallelFor(0, n, BLOCK_SIZE, [&](std::size_t begin, std::size_t end)
+	{
+		if (!spline)
+		{
+			accumulateFromBodies(bodyX.data(), bodyY.data(), bodyZ.data(), bodyMass.data(), bodies,
+				particles.x.data() + begin, particles.y.data() + begin, particles.z.data() + begin, end - begin,
+				softening * softening, GRAVITATIONAL_CONSTANT, particles.ax.data() + begin, particles.ay.data() + begin, particles.az.data() + begin);
+			return;
+		}
+
+		// The spline's piecewise polynomial goes through the per-particle kernel, which only pays for it near a body
+		for (std::size_t i = begin; i < end; i++)
+		{
+			float accX, accY, accZ;
+			bodyPull(particles, i, bodyX, bodyY, bodyZ, bodyMass, softening, kernel, accX, accY, accZ);
+			particles.ax[i] = GRAVITATIONAL_CONSTANT * accX;
+			particles.ay[i] = GRAVITATIONAL_CONSTANT * accY;
+			particles.az[i] = GRAVITATIONAL_CONSTANT * accZ;
+		}
+	});
+}
+
+void MassiveBodyGravity::computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active)
+{
+	gatherBodies(particles);
+
+	parallelFor(0, active.size(), BLOCK_SIZE, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t k = begin; k < end; k++)
+		{
+			std::uint32_t i = active[k];
+			float accX, accY, accZ;
+			bodyPull(particles, i, bodyX, bodyY, bodyZ, bodyMass, softening, kernel, accX, accY, accZ);
+			particles.ax[i] = GRAVITATIONAL_CONSTANT * accX;
+			particles.ay[i] = GRAVITATIONAL_CONSTANT * accY;
+			particles.az[i] = GRAVITATIONAL_CONSTANT * accZ;
+		}
+	});
+}
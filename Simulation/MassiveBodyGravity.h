@@ -0,0 +1,46 @@
+#ifndef MASSIVE_BODY_GRAVITY_H
+#define MASSIVE_BODY_GRAVITY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "ForceSolver.h"
+#include "Softening.h"
+
+// Splits the particles into a few massive bodies, which attract each other and everything else, and test particles,
+// which feel the bodies but pull on nothing. This is the general form of the original sun-only model (CentralGravity
+// with one body) for planetary rings and debris disks, where millions of dust grains orbit a star and a few planets at
+// O(N * M) cost. The bodies are gathered into compact arrays on every call and the particles are streamed past them
+// with the transposed kernel in GravityKernel.h (accumulateFromBodies).
+class MassiveBodyGravity : public ForceSolver
+{
+	public:
+		// Particles per chunk of the streaming loop
+		static const std::size_t BLOCK_SIZE = 4096;
+
+		// Particles with mass above massThreshold are bodies, the rest are test particles whose own pull is ignored.
+		// softening as for DirectGravity.
+		explicit MassiveBodyGravity(float softening = 0.0f, SofteningKernel kernel = SOFTENING_PLUMMER, float massThreshold = 0.0f)
+			: softening(softening), kernel(kernel), massThreshold(massThreshold) {}
+
+		void computeAccelerations(ParticleStore& particles) override;
+		void computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active) override;
+		const char* name() const override { return "massive"; }
+
+		// Number of bodies found by the latest evaluation
+		std::size_t bodyCount() const { return bodyMass.size(); }
+
+	private:
+		float softening;
+		SofteningKernel kernel;
+		float massThreshold;
+
+		// Positions and masses of the bodies, gathered from the store on every call
+		AlignedVector<float> bodyX, bodyY, bodyZ, bodyMass;
+
+		void gatherBodies(const ParticleStore& particles);
+};
+
+#endif
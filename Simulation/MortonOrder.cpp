@@ -0,0 +1,167 @@
+#include "MortonOrder.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "Parallel.h"
+
+// Keys per chunk of the bounding box, key and radix passes
+static const std::size_t SORT_GRAIN = 65536;
+// Key bits sorted per radix pass
+static const unsigned int RADIX_BITS = 8;
+static const std::size_t RADIX_BUCKETS = std::size_t(1) << RADIX_BITS;
+
+struct Bounds
+{
+	float min[3];
+	float max[3];
+};
+
+static Bounds measureBounds(const ParticleStore& particles, std::size_t first)
+{
+	Bounds empty = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	const float* coordinates[] = { particles.x.data(), particles.y.data(), particles.z.data() };
+
+	return parallelReduce(first, particles.size(), SORT_GRAIN, empty, [&](std::size_t begin, std::size_t end)
+	{
+		Bounds chunk = empty;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (std::size_t i = begin; i < end; i++)
+			{
+				chunk.min[axis] = std::min(chunk.min[axis], coordinates[axis][i]);
+				chunk.max[axis] = std::max(chunk.max[axis], coordinates[axis][i]);
+			}
+		}
+		return chunk;
+	},
+	[](const Bounds& a, const Bounds& b)
+	{
+		Bounds sum;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			sum.min[axis] = std::min(a.min[axis], b.min[axis]);
+			sum.max[axis] = std::max(a.max[axis], b.max[axis]);
+		}
+		return sum;
+	});
+}
+
+// Cell of value along one axis, clamped so rounding at the top edge can't overflow the 21 bits
+static inline std::uint32_t mortonCell(float value, float low, float scale)
+{
+	float cell = (value - low) * scale;
+	const float top = (float)((1u << MORTON_BITS_PER_AXIS) - 1);
+	return (std::uint32_t)std::min(std::max(cell, 0.0f), top);
+}
+
+// One stable counting-sort pass of LSD radix sort on the digit at shift. Each chunk counts its digits, the counts are
+// turned into per-chunk start offsets (bucket by bucket, chunk by chunk) and every chunk scatters its keys in order.
+// Returns false without touching anything when every key has the same digit.
+static bool radixPass(const std::vector<std::uint64_t>& keys, const std::vector<std::uint32_t>& indices,
+	std::vector<std::uint64_t>& sortedKeys, std::vector<std::uint32_t>& sortedIndices, unsigned int shift)
+{
+	std::size_t n = keys.size();
+	std::size_t chunks = (n + SORT_GRAIN - 1) / SORT_GRAIN;
+	std::vector<std::size_t> offsets(chunks * RADIX_BUCKETS, 0);
+
+	parallelFor(0, n, SORT_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t b = begin; b < end; b += SORT_GRAIN)
+		{
+			std::size_t* counts = &offsets[b / SORT_GRAIN * RADIX_BUCKETS];
+			for (std::size_t i = b; i < std::min(b + SORT_GRAIN, end); i++)
+			{
+				counts[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+			}
+		}
+	});
+
+	std::size_t start = 0;
+	for (std::size_t bucket = 0; bucket < RADIX_BUCKETS; bucket++)
+	{
+		for (std::size_t c = 0; c < chunks; c++)
+		{
+			std::size_t count = offsets[c * RADIX_BUCKETS + bucket];
+			if (count == n)
+			{
+				return false;
+			}
+			offsets[c * RADIX_BUCKETS + bucket] = start;
+			start += count;
+		}
+	}
+
+	parallelFor(0, n, SORT_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t b = begin; b < end; b += SORT_GRAIN)
+		{
+			std::size_t* next = &offsets[b / SORT_GRAIN * RADIX_BUCKETS];
+			for (std::size_t i = b; i < std::min(b + SORT_GRAIN, end); i++)
+			{
+				std::size_t slot = next[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+				sortedKeys[slot] = keys[i];
+				sortedIndices[slot] = indices[i];
+			}
+		}
+	});
+	return true;
+}
+
+void mortonOrder(const ParticleStore& particles, std::size_t first, std::vector<std::uint32_t>& order)
+{
+	std::size_t total = particles.size();
+	first = std::min(first, total);
+	order.resize(total);
+	for (std::size_t i = 0; i < first; i++)
+	{
+		order[i] = (std::uint32_t)i;
+	}
+
+	std::size_t n = total - first;
+	if (n < 2)
+	{
+		for (std::size_t i = first; i < total; i++)
+		{
+			order[i] = (std::uint32_t)i;
+		}
+		return;
+	}
+
+	// One cube spanning the longest side, so the curve has the same resolution along every axis
+	Bounds bounds = measureBounds(particles, first);
+	float extent = std::max(std::max(bounds.max[0] - bounds.min[0], bounds.max[1] - bounds.min[1]), bounds.max[2] - bounds.min[2]);
+	float scale = extent > 0.0f ? (float)(1u << MORTON_BITS_PER_AXIS) / extent : 0.0f;
+
+	std::vector<std::uint64_t> keys(n), sortedKeys(n);
+	std::vector<std::uint32_t> indices(n), sortedIndices(n);
+	parallelFor(0, n, SORT_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t k = begin; k < end; k++)
+		{
+			std::size_t i = first + k;
+			keys[k] = mortonKey(mortonCell(particles.x[i], bounds.min[0], scale),
+				mortonCell(particles.y[i], bounds.min[1], scale),
+				mortonCell(particles.z[i], bounds.min[2], scale));
+			indices[k] = (std::uint32_t)i;
+		}
+	});
+
+	for (unsigned int shift = 0; shift < 3 * MORTON_BITS_PER_AXIS; shift += RADIX_BITS)
+	{
+		if (radixPass(keys, indices, sortedKeys, sortedIndices, shift))
+		{
+			keys.swap(sortedKeys);
+			indices.swap(sortedIndices);
+		}
+	}
+
+	std::copy(indices.begin(), indices.end(), order.begin() + first);
+}
+
+void sortByMorton(ParticleStore& particles, std::size_t first)
+{
+	std::vector<std::uint32_t> order;
+	mortonOrder(particles, first, order);
+	particles.permute(order);
+}
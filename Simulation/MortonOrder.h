@@ -0,0 +1,41 @@
+#ifndef MORTON_ORDER_H
+#define MORTON_ORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ParticleStore.h"
+
+// Bits of each coordinate in a Morton key, three of them interleaved make a 63-bit key
+const unsigned int MORTON_BITS_PER_AXIS = 21;
+
+// Spreads the low 21 bits of v so bit k lands on bit 3k
+inline std::uint64_t spreadMortonBits(std::uint64_t v)
+{
+	v &= 0x1FFFFF;
+	v = (v | v << 32) & 0x1F00000000FFFFull;
+	v = (v | v << 16) & 0x1F0000FF0000FFull;
+	v = (v | v << 8) & 0x100F00F00F00F00Full;
+	v = (v | v << 4) & 0x10C30C30C30C30C3ull;
+	v = (v | v << 2) & 0x1249249249249249ull;
+	return v;
+}
+
+// Position along the Z-order curve of the cell (x, y, z), each coordinate in [0, 2^21)
+inline std::uint64_t mortonKey(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+{
+	return spreadMortonBits(x) | spreadMortonBits(y) << 1 | spreadMortonBits(z) << 2;
+}
+
+// Fills order with the particle indices of [first, size()) sorted along a Z-order curve over their bounding box,
+// preceded by 0 .. first - 1 unchanged, ready for ParticleStore::permute. Particles in the same cell keep their current
+// relative order (the parallel radix sort is stable), so the result is the same for any thread count.
+void mortonOrder(const ParticleStore& particles, std::size_t first, std::vector<std::uint32_t>& order);
+
+// Reorders the particles from first on along the Z-order curve so particles close in space are close in memory, which
+// keeps the octree walks and the neighbour loops in cache. The particles before first stay where they are; the default
+// keeps the sun at index 0, where the sun-aware solvers and integrators look for it.
+void sortByMorton(ParticleStore& particles, std::size_t first = 1);
+
+#endif
@@ -0,0 +1,190 @@
+#include "Octree.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.h"
+
+// Deeper than this the cell is smaller than float resolution, so coincident particles just share a big leaf
+static const int MAX_DEPTH = 32;
+// The top of the tree is split serially until there are this many subtrees to build in parallel. A fixed number
+// rather than one per thread keeps the node layout identical for every thread count.
+static const std::size_t PARALLEL_SUBTREES = 512;
+
+void Octree::build(const ParticleStore& particles, unsigned int leafSize)
+{
+	std::size_t n = particles.size();
+	nodes.clear();
+	order.resize(n);
+	scratch.resize(n);
+	sorted.resize(n);
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		order[i] = static_cast<std::uint32_t>(i);
+	}
+
+	if (n == 0)
+	{
+		return;
+	}
+
+	// Bounding cube of every particle
+	float minX = particles.x[0], maxX = minX;
+	float minY = particles.y[0], maxY = minY;
+	float minZ = particles.z[0], maxZ = minZ;
+	for (std::size_t i = 1; i < n; i++)
+	{
+		minX = std::min(minX, particles.x[i]);
+		maxX = std::max(maxX, particles.x[i]);
+		minY = std::min(minY, particles.y[i]);
+		maxY = std::max(maxY, particles.y[i]);
+		minZ = std::min(minZ, particles.z[i]);
+		maxZ = std::max(maxZ, particles.z[i]);
+	}
+
+	OctreeNode root;
+	root.centerX = 0.5f * (minX + maxX);
+	root.centerY = 0.5f * (minY + maxY);
+	root.centerZ = 0.5f * (minZ + maxZ);
+	// Slightly enlarged so particles on the boundary are strictly inside
+	root.halfSize = 0.5f * std::max(maxX - minX, std::max(maxY - minY, maxZ - minZ)) * 1.001f + 1e-6f;
+	root.begin = 0;
+	root.count = static_cast<std::uint32_t>(n);
+	root.firstChild = -1;
+	root.childCount = 0;
+	nodes.push_back(root);
+	leafSize = std::max(leafSize, 1u);
+
+	// Breadth-first over the top levels until there is enough independent work, each frontier node owns a disjoint
+	// slice of order[] so its subtree can be built on any thread
+	std::vector<std::uint32_t> frontier(1, 0);
+	int depth = 0;
+	while (!frontier.empty() && frontier.size() < PARALLEL_SUBTREES && depth < MAX_DEPTH)
+	{
+		std::vector<std::uint32_t> next;
+		for (std::uint32_t n : frontier)
+		{
+			if (splitNode(particles, nodes, n, leafSize, depth))
+			{
+				for (std::uint32_t c = 0; c < nodes[n].childCount; c++)
+				{
+					next.push_back(nodes[n].firstChild + c);
+				}
+			}
+		}
+		frontier.swap(next);
+		depth++;
+	}
+
+	std::vector<std::vector<OctreeNode>> subtrees(frontier.size());
+	parallelFor(0, frontier.size(), 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t f = begin; f < end; f++)
+		{
+			subtrees[f].assign(1, nodes[frontier[f]]);
+			split(particles, subtrees[f], 0, leafSize, depth);
+		}
+	});
+
+	// Append each subtree below the existing nodes, shifting its child links; children still follow their parents
+	for (std::size_t f = 0; f < frontier.size(); f++)
+	{
+		const std::vector<OctreeNode>& subtree = subtrees[f];
+		std::int32_t shift = static_cast<std::int32_t>(nodes.size()) - 1;
+		OctreeNode& top = nodes[frontier[f]];
+		if (!isLeaf(subtree[0]))
+		{
+			top.firstChild = subtree[0].firstChild + shift;
+			top.childCount = subtree[0].childCount;
+		}
+		for (std::size_t k = 1; k < subtree.size(); k++)
+		{
+			OctreeNode node = subtree[k];
+			if (!isLeaf(node))
+			{
+				node.firstChild += shift;
+			}
+			nodes.push_back(node);
+		}
+	}
+}
+
+void Octree::split(const ParticleStore& particles, std::vector<OctreeNode>& tree, std::uint32_t nodeIndex, unsigned int leafSize, int depth)
+{
+	if (!splitNode(particles, tree, nodeIndex, leafSize, depth))
+	{
+		return;
+	}
+
+	std::uint32_t firstChild = static_cast<std::uint32_t>(tree[nodeIndex].firstChild);
+	std::uint32_t childCount = tree[nodeIndex].childCount;
+	for (std::uint32_t c = 0; c < childCount; c++)
+	{
+		split(particles, tree, firstChild + c, leafSize, depth + 1);
+	}
+}
+
+bool Octree::splitNode(const ParticleStore& particles, std::vector<OctreeNode>& tree, std::uint32_t nodeIndex, unsigned int leafSize, int depth)
+{
+	OctreeNode node = tree[nodeIndex];
+	if (node.count <= leafSize || depth >= MAX_DEPTH)
+	{
+		return false;
+	}
+
+	// Counting sort of the node's particles by octant: bit 0 = x, bit 1 = y, bit 2 = z above the center
+	std::uint32_t counts[8] = { 0 };
+	for (std::uint32_t k = node.begin; k < node.begin + node.count; k++)
+	{
+		std::uint32_t i = order[k];
+		int octant = (particles.x[i] > node.centerX) | ((particles.y[i] > node.centerY) << 1) | ((particles.z[i] > node.centerZ) << 2);
+		scratch[k] = octant;
+		counts[octant]++;
+	}
+
+	std::uint32_t offsets[8];
+	std::uint32_t offset = node.begin;
+	for (int c = 0; c < 8; c++)
+	{
+		offsets[c] = offset;
+		offset += counts[c];
+	}
+
+	std::uint32_t cursor[8];
+	std::copy(offsets, offsets + 8, cursor);
+	for (std::uint32_t k = node.begin; k < node.begin + node.count; k++)
+	{
+		sorted[cursor[scratch[k]]++] = order[k];
+	}
+	std::copy(sorted.begin() + node.begin, sorted.begin() + node.begin + node.count, order.begin() + node.begin);
+
+	// Children are appended together so they stay contiguous
+	std::uint32_t firstChild = static_cast<std::uint32_t>(tree.size());
+	std::uint32_t childCount = 0;
+	float quarter = 0.5f * node.halfSize;
+
+	for (int c = 0; c < 8; c++)
+	{
+		if (counts[c] == 0)
+		{
+			continue;
+		}
+
+		OctreeNode child;
+		child.centerX = node.centerX + ((c & 1) ? quarter : -quarter);
+		child.centerY = node.centerY + ((c & 2) ? quarter : -quarter);
+		child.centerZ = node.centerZ + ((c & 4) ? quarter : -quarter);
+		child.halfSize = quarter;
+		child.begin = offsets[c];
+		child.count = counts[c];
+		child.firstChild = -1;
+		child.childCount = 0;
+		tree.push_back(child);
+		childCount++;
+	}
+
+	tree[nodeIndex].firstChild = static_cast<std::int32_t>(firstChild);
+	tree[nodeIndex].childCount = childCount;
+	return true;
+}
@@ -0,0 +1,48 @@
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ParticleStore.h"
+
+// A cube of space. Its particles are order[begin, begin + count) and its non-empty children are stored next to each other.
+struct OctreeNode
+{
+	float centerX, centerY, centerZ;
+	float halfSize;
+	std::uint32_t begin;
+	std::uint32_t count;
+	// Index of the first child in Octree::nodes, -1 for leaves
+	std::int32_t firstChild;
+	std::uint32_t childCount;
+};
+
+// Spatial octree over the particle positions, shared by the hierarchical solvers.
+// A child always has a larger index than its parent, so walking the array backwards visits children first. The top
+// levels are split serially and the subtrees below them are built in parallel, then appended one after another.
+class Octree
+{
+	public:
+		std::vector<OctreeNode> nodes;
+		// Particle indices grouped so each node's particles are contiguous
+		std::vector<std::uint32_t> order;
+
+		// Rebuilds the tree, splitting nodes until they hold at most leafSize particles
+		void build(const ParticleStore& particles, unsigned int leafSize);
+
+		static bool isLeaf(const OctreeNode& node) { return node.firstChild < 0; }
+
+	private:
+		// Octant of each particle and the reordered indices while a node is being split
+		std::vector<std::uint32_t> scratch;
+		std::vector<std::uint32_t> sorted;
+
+		// Splits tree[nodeIndex] and everything below it, appending the new nodes to tree
+		void split(const ParticleStore& particles, std::vector<OctreeNode>& tree, std::uint32_t nodeIndex, unsigned int leafSize, int depth);
+		// Splits one node into its non-empty octants, returns false if it stays a leaf
+		bool splitNode(const ParticleStore& particles, std::vector<OctreeNode>& tree, std::uint32_t nodeIndex, unsigned int leafSize, int depth);
+};
+
+#endif
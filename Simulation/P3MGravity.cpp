@@ -0,0 +1,291 @@
+#include "P3MGravity.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.h"
+
+static const int TABLE_SIZE = 1024;
+
+P3MGravity::P3MGravity(unsigned int gridSize, float periodicBox, float splitCells, float cutoff)
+	: PMGravity(gridSize, periodicBox), splitCells(splitCells), cutoff(cutoff), softening(0.0f), softeningKernel(SOFTENING_PLUMMER),
+	tableCutoff(0.0f), cellsX(0), cellsY(0), cellsZ(0), meshSplitScale(0.0f)
+{
+}
+
+void P3MGravity::computeAccelerations(ParticleStore& particles)
+{
+	particles.clearAccelerations();
+	if (particles.empty())
+	{
+		return;
+	}
+
+	addMeshAccelerations(particles, splitCells);
+
+	std::size_t n = particles.size();
+	meshAx.assign(particles.ax.begin(), particles.ax.begin() + n);
+	meshAy.assign(particles.ay.begin(), particles.ay.begin() + n);
+	meshAz.assign(particles.az.begin(), particles.az.begin() + n);
+	meshSplitScale = splitCells * meshCellSize();
+
+	addShortRange(particles, meshSplitScale);
+}
+
+void P3MGravity::computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active)
+{
+	// Everything active, or no mesh force for these particles yet: a full evaluation, which also refreshes the mesh
+	if (active.size() == particles.size() || meshAx.size() != particles.size())
+	{
+		computeAccelerations(particles);
+		return;
+	}
+
+	if (tableCutoff != cutoff || shortRangeTable.empty())
+	{
+		buildTable();
+	}
+	buildCellList(particles, cutoff * meshSplitScale);
+
+	parallelFor(0, active.size(), 16, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t k = begin; k < end; k++)
+		{
+			std::uint32_t i = active[k];
+			std::uint32_t neighbours[27];
+			int neighbourCount = neighbourCells(particleCell[i], neighbours);
+
+			float acc[3];
+			shortRangeOn(particleSlot[i], neighbours, neighbourCount, meshSplitScale, acc);
+			particles.ax[i] = meshAx[i] + GRAVITATIONAL_CONSTANT * acc[0];
+			particles.ay[i] = meshAy[i] + GRAVITATIONAL_CONSTANT * acc[1];
+			particles.az[i] = meshAz[i] + GRAVITATIONAL_CONSTANT * acc[2];
+		}
+	});
+}
+
+void P3MGravity::buildTable()
+{
+	shortRangeTable.resize(TABLE_SIZE + 1);
+	for (int t = 0; t <= TABLE_SIZE; t++)
+	{
+		double u = cutoff * t / TABLE_SIZE;
+		shortRangeTable[t] = (float)(std::erfc(0.5 * u) + u / std::sqrt(3.14159265358979323846) * std::exp(-0.25 * u * u));
+	}
+	tableCutoff = cutoff;
+}
+
+void P3MGravity::buildCellList(const ParticleStore& particles, float cellLength)
+{
+	std::size_t n = particles.size();
+	bool periodic = periodicBox > 0.0f;
+
+	float minX = 0.0f, minY = 0.0f, minZ = 0.0f;
+	float extentX = periodicBox, extentY = periodicBox, extentZ = periodicBox;
+	if (!periodic)
+	{
+		float maxX = particles.x[0], maxY = particles.y[0], maxZ = particles.z[0];
+		minX = maxX;
+		minY = maxY;
+		minZ = maxZ;
+		for (std::size_t i = 1; i < n; i++)
+		{
+			minX = std::min(minX, particles.x[i]);
+			maxX = std::max(maxX, particles.x[i]);
+			minY = std::min(minY, particles.y[i]);
+			maxY = std::max(maxY, particles.y[i]);
+			minZ = std::min(minZ, particles.z[i]);
+			maxZ = std::max(maxZ, particles.z[i]);
+		}
+		extentX = maxX - minX;
+		extentY = maxY - minY;
+		extentZ = maxZ - minZ;
+	}
+
+	// Cells at least one cutoff wide, so only the 27 surrounding cells can hold partners. Periodic grids need 3 cells
+	// per side for the neighbours to be distinct, otherwise that axis collapses to a single cell.
+	auto cellsAlong = [&](float extent)
+	{
+		int cells = std::max(1, (int)std::min(1024.0f, std::floor(extent / cellLength)));
+		return (periodic && cells < 3) ? 1 : cells;
+	};
+	cellsX = cellsAlong(extentX);
+	cellsY = cellsAlong(extentY);
+	cellsZ = cellsAlong(extentZ);
+
+	auto cellIndex = [&](std::size_t i)
+	{
+		auto axis = [&](float position, float origin, float extent, int cells)
+		{
+			float u = extent > 0.0f ? (position - origin) / extent * cells : 0.0f;
+			int c = (int)std::floor(u);
+			if (periodic)
+			{
+				c %= cells;
+				return c < 0 ? c + cells : c;
+			}
+			return std::max(0, std::min(cells - 1, c));
+		};
+		int cx = axis(particles.x[i], minX, extentX, cellsX);
+		int cy = axis(particles.y[i], minY, extentY, cellsY);
+		int cz = axis(particles.z[i], minZ, extentZ, cellsZ);
+		return (std::uint32_t)((cx * cellsY + cy) * cellsZ + cz);
+	};
+
+	std::size_t cells = (std::size_t)cellsX * cellsY * cellsZ;
+	particleCell.resize(n);
+	cellStart.assign(cells + 1, 0);
+	for (std::size_t i = 0; i < n; i++)
+	{
+		particleCell[i] = cellIndex(i);
+		cellStart[particleCell[i] + 1]++;
+	}
+	for (std::size_t c = 0; c < cells; c++)
+	{
+		cellStart[c + 1] += cellStart[c];
+	}
+
+	std::vector<std::uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+	sortedIndex.resize(n);
+	particleSlot.resize(n);
+	for (std::size_t i = 0; i < n; i++)
+	{
+		particleSlot[i] = cursor[particleCell[i]]++;
+		sortedIndex[particleSlot[i]] = (std::uint32_t)i;
+	}
+
+	sortedX.resize(n);
+	sortedY.resize(n);
+	sortedZ.resize(n);
+	sortedMass.resize(n);
+	for (std::size_t k = 0; k < n; k++)
+	{
+		std::uint32_t i = sortedIndex[k];
+		sortedX[k] = particles.x[i];
+		sortedY[k] = particles.y[i];
+		sortedZ[k] = particles.z[i];
+		sortedMass[k] = particles.mass[i];
+	}
+}
+
+void P3MGravity::addShortRange(ParticleStore& particles, float splitScale)
+{
+	if (tableCutoff != cutoff || shortRangeTable.empty())
+	{
+		buildTable();
+	}
+
+	buildCellList(particles, cutoff * splitScale);
+
+	parallelFor(0, (std::size_t)cellsX * cellsY * cellsZ, 4, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t cell = begin; cell < end; cell++)
+		{
+			std::uint32_t neighbours[27];
+			int neighbourCount = neighbourCells(cell, neighbours);
+
+			for (std::uint32_t a = cellStart[cell]; a < cellStart[cell + 1]; a++)
+			{
+				float acc[3];
+				shortRangeOn(a, neighbours, neighbourCount, splitScale, acc);
+
+				std::uint32_t i = sortedIndex[a];
+				particles.ax[i] += GRAVITATIONAL_CONSTANT * acc[0];
+				particles.ay[i] += GRAVITATIONAL_CONSTANT * acc[1];
+				particles.az[i] += GRAVITATIONAL_CONSTANT * acc[2];
+			}
+		}
+	});
+}
+
+int P3MGravity::neighbourCells(std::size_t cell, std::uint32_t* neighbours) const
+{
+	const bool periodic = periodicBox > 0.0f;
+	int cx = (int)(cell / ((std::size_t)cellsY * cellsZ));
+	int cy = (int)((cell / cellsZ) % cellsY);
+	int cz = (int)(cell % cellsZ);
+
+	// Wrapped for periodic boxes and clipped otherwise
+	int neighbourCount = 0;
+	for (int ox = -1; ox <= 1; ox++)
+	{
+		for (int oy = -1; oy <= 1; oy++)
+		{
+			for (int oz = -1; oz <= 1; oz++)
+			{
+				int nx = cx + ox, ny = cy + oy, nz = cz + oz;
+				if (periodic)
+				{
+					nx = (nx + cellsX) % cellsX;
+					ny = (ny + cellsY) % cellsY;
+					nz = (nz + cellsZ) % cellsZ;
+				}
+				else if (nx < 0 || ny < 0 || nz < 0 || nx >= cellsX || ny >= cellsY || nz >= cellsZ)
+				{
+					continue;
+				}
+
+				std::uint32_t neighbour = (std::uint32_t)((nx * cellsY + ny) * cellsZ + nz);
+				if (std::find(neighbours, neighbours + neighbourCount, neighbour) == neighbours + neighbourCount)
+				{
+					neighbours[neighbourCount++] = neighbour;
+				}
+			}
+		}
+	}
+	std::sort(neighbours, neighbours + neighbourCount);
+	return neighbourCount;
+}
+
+void P3MGravity::shortRangeOn(std::uint32_t a, const std::uint32_t* neighbours, int neighbourCount, float splitScale, float* acc) const
+{
+	const float radius = cutoff * splitScale;
+	const float radius2 = radius * radius;
+	const float tableScale = TABLE_SIZE / radius;
+	const bool periodic = periodicBox > 0.0f;
+	const float box = periodicBox;
+	const bool softened = softening > 0.0f;
+
+	const float xi = sortedX[a], yi = sortedY[a], zi = sortedZ[a];
+	float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+
+	for (int c = 0; c < neighbourCount; c++)
+	{
+		std::uint32_t other = neighbours[c];
+		for (std::uint32_t b = cellStart[other]; b < cellStart[other + 1]; b++)
+		{
+			float dx = sortedX[b] - xi;
+			float dy = sortedY[b] - yi;
+			float dz = sortedZ[b] - zi;
+			if (periodic)
+			{
+				// Minimum image
+				dx -= box * std::nearbyint(dx / box);
+				dy -= box * std::nearbyint(dy / box);
+				dz -= box * std::nearbyint(dz / box);
+			}
+
+			float r2 = dx * dx + dy * dy + dz * dz;
+			if (r2 >= radius2 || r2 == 0.0f || sortedMass[b] == 0.0f)
+			{
+				continue;
+			}
+
+			float r = std::sqrt(r2);
+			float u = r * tableScale;
+			int t = std::min((int)u, TABLE_SIZE - 1);
+			float f = u - t;
+			float factor = shortRangeTable[t] + f * (shortRangeTable[t + 1] - shortRangeTable[t]);
+			float invR3 = 1.0f / (r2 * r);
+			// Softened: replace the Newtonian part 1 / r^3 by the softened one, the mesh's (1 - factor) / r^3 stays
+			float s = sortedMass[b] * (softened ? softenedForceFactor(r2, softening, softeningKernel) - (1.0f - factor) * invR3 : factor * invR3);
+			accX += dx * s;
+			accY += dy * s;
+			accZ += dz * s;
+		}
+	}
+
+	acc[0] = accX;
+	acc[1] = accY;
+	acc[2] = accZ;
+}
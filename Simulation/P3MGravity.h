@@ -0,0 +1,58 @@
+#ifndef P3M_GRAVITY_H
+#define P3M_GRAVITY_H
+
+#include <cstdint>
+#include <vector>
+
+#include "PMGravity.h"
+#include "Softening.h"
+
+// Particle-Particle Particle-Mesh gravity. The 1/r potential is split with a Gaussian of scale rs: the smooth long-range
+// part erf(r / 2rs) / r comes from the mesh, and the short-range remainder erfc(r / 2rs) / r is summed directly between
+// particles closer than cutoff * rs, found with a cell list. Keeps PM speed without losing resolution in clustered regions.
+// Softening goes into the short-range sum: each pair gets the softened Newtonian force minus the mesh's long-range part,
+// so close pairs feel the same softened force as with the pairwise solvers and the mesh is left as it is.
+// Active evaluations (block timesteps) only redo the short-range sum for the active particles and reuse the long-range
+// mesh force of the last full evaluation, which changes on the scale of rs and is refreshed whenever every particle is
+// active, as at the end of each block step. Without that every sub-step would pay for a full mesh solve.
+class P3MGravity : public PMGravity
+{
+	public:
+		// Split scale rs in mesh cells
+		float splitCells;
+		// Short-range cutoff in units of rs, the erfc term is below 1.5e-3 of Newton past 4.5 rs
+		float cutoff;
+		float softening;
+		// Plummer by default; with the spline kernel softening is the Plummer-equivalent length
+		SofteningKernel softeningKernel;
+
+		explicit P3MGravity(unsigned int gridSize = 64, float periodicBox = 0.0f, float splitCells = 1.25f, float cutoff = 4.5f);
+
+		void computeAccelerations(ParticleStore& particles) override;
+		void computeActiveAccelerations(ParticleStore& particles, const std::vector<std::uint32_t>& active) override;
+		const char* name() const override { return "p3m"; }
+
+	private:
+		// Short-range force factor erfc(u / 2) + u / sqrt(pi) exp(-u^2 / 4) tabulated over u = r / rs in [0, cutoff]
+		std::vector<float> shortRangeTable;
+		float tableCutoff;
+
+		// Cell list: particles sorted by cell, with their original index, and each particle's cell and sorted slot
+		int cellsX, cellsY, cellsZ;
+		std::vector<std::uint32_t> cellStart, sortedIndex, particleCell, particleSlot;
+		AlignedVector<float> sortedX, sortedY, sortedZ, sortedMass;
+
+		// Long-range mesh acceleration of every particle and the split scale of the last full evaluation
+		std::vector<float> meshAx, meshAy, meshAz;
+		float meshSplitScale;
+
+		void buildTable();
+		void buildCellList(const ParticleStore& particles, float cellLength);
+		void addShortRange(ParticleStore& particles, float splitScale);
+		// Cells whose particles can be within the cutoff of particles in cell, each listed once; returns the count
+		int neighbourCells(std::size_t cell, std::uint32_t* neighbours) const;
+		// Short-range acceleration (without G) on the particle in sorted slot a from the particles of the listed cells
+		void shortRangeOn(std::uint32_t a, const std::uint32_t* neighbours, int neighbourCount, float splitScale, float* acc) const;
+};
+
+#endif
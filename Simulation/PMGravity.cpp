@@ -0,0 +1,379 @@
+#include "PMGravity.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.h"
+
+static const double PI = 3.14159265358979323846;
+
+// Isolated meshes keep this many empty cells around the particles so the 4-point stencil never leaves the mesh
+static const int BORDER_CELLS = 4;
+
+void PMGravity::computeAccelerations(ParticleStore& particles)
+{
+	particles.clearAccelerations();
+	if (particles.empty())
+	{
+		return;
+	}
+
+	addMeshAccelerations(particles, 0.0f);
+}
+
+void PMGravity::addMeshAccelerations(ParticleStore& particles, float splitCells)
+{
+	std::size_t n = gridSize;
+	bool periodic = periodicBox > 0.0f;
+
+	if (cachedSize != gridSize || cachedPeriodic != periodic)
+	{
+		buildGreen();
+	}
+
+	density.assign(n * n * n, 0.0f);
+	potential.resize(n * n * n);
+	forceX.resize(n * n * n);
+	forceY.resize(n * n * n);
+	forceZ.resize(n * n * n);
+
+	placeMesh(particles);
+	deposit(particles);
+	solvePotential(splitCells * cellSize);
+	differentiate();
+	interpolate(particles);
+}
+
+// --------------------- MESH SETUP ---------------------
+
+void PMGravity::placeMesh(const ParticleStore& particles)
+{
+	std::size_t count = particles.size();
+
+	if (periodicBox > 0.0f)
+	{
+		cellSize = periodicBox / gridSize;
+		originX = originY = originZ = 0.0f;
+		return;
+	}
+
+	float minX = particles.x[0], maxX = minX;
+	float minY = particles.y[0], maxY = minY;
+	float minZ = particles.z[0], maxZ = minZ;
+	for (std::size_t i = 1; i < count; i++)
+	{
+		minX = std::min(minX, particles.x[i]);
+		maxX = std::max(maxX, particles.x[i]);
+		minY = std::min(minY, particles.y[i]);
+		maxY = std::max(maxY, particles.y[i]);
+		minZ = std::min(minZ, particles.z[i]);
+		maxZ = std::max(maxZ, particles.z[i]);
+	}
+
+	float extent = std::max(maxX - minX, std::max(maxY - minY, maxZ - minZ));
+	cellSize = extent > 0.0f ? extent / (gridSize - 2 * BORDER_CELLS) : 1.0f;
+	// Slightly larger so rounding never pushes a particle past the last usable node
+	cellSize *= 1.0001f;
+	originX = minX - BORDER_CELLS * cellSize;
+	originY = minY - BORDER_CELLS * cellSize;
+	originZ = minZ - BORDER_CELLS * cellSize;
+}
+
+void PMGravity::buildGreen()
+{
+	bool periodic = periodicBox > 0.0f;
+	std::size_t n = gridSize;
+	// Isolated boundaries convolve on a doubled mesh so the periodic images never overlap the particles
+	std::size_t m = periodic ? n : 2 * n;
+
+	fft.resize(m);
+	work.resize(m * m * m);
+	green.assign(m * m * m, Fft3d::Complex(0.0f, 0.0f));
+
+	auto signedIndex = [m](std::size_t i) { return i < m / 2 ? (double)i : (double)i - (double)m; };
+
+	parallelFor(0, m, 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+		{
+			for (std::size_t j = 0; j < m; j++)
+			{
+				for (std::size_t k = 0; k < m; k++)
+				{
+					double a = signedIndex(i), b = signedIndex(j), c = signedIndex(k);
+					double value;
+
+					if (periodic)
+					{
+						// -4 pi / k^2 in Fourier space, the mean density (k = 0) is dropped
+						double k2 = (2.0 * PI / m) * (2.0 * PI / m) * (a * a + b * b + c * c);
+						value = k2 > 0.0 ? -4.0 * PI / k2 : 0.0;
+					}
+					else
+					{
+						// -1 / r in real space, the origin uses the mean of 1 / r over a unit cube (2.38) as its self potential
+						double r = std::sqrt(a * a + b * b + c * c);
+						value = r > 0.0 ? -1.0 / r : -2.38;
+					}
+
+					green[(i * m + j) * m + k] = Fft3d::Complex((float)value, 0.0f);
+				}
+			}
+		}
+	});
+
+	if (!periodic)
+	{
+		fft.forward(green.data());
+	}
+
+	cachedSize = gridSize;
+	cachedPeriodic = periodic;
+}
+
+void PMGravity::cloudInCell(float position, float origin, int& node, float& weight) const
+{
+	float u = (position - origin) / cellSize;
+	float lower = std::floor(u);
+	node = (int)lower;
+	weight = u - lower;
+}
+
+std::size_t PMGravity::wrap(int node) const
+{
+	int n = (int)gridSize;
+	if (periodicBox > 0.0f)
+	{
+		node %= n;
+		return (std::size_t)(node < 0 ? node + n : node);
+	}
+	return (std::size_t)std::max(0, std::min(n - 1, node));
+}
+
+// --------------------- MASS ASSIGNMENT ---------------------
+
+void PMGravity::deposit(const ParticleStore& particles)
+{
+	std::size_t count = particles.size();
+	std::size_t n = gridSize;
+
+	// Bin particles by slab with a counting sort, keeping index order inside each slab
+	slabStart.assign(n + 1, 0);
+	slabParticles.resize(count);
+	std::vector<std::uint32_t> particleSlab(count);
+	for (std::size_t i = 0; i < count; i++)
+	{
+		int node;
+		float weight;
+		cloudInCell(particles.x[i], originX, node, weight);
+		particleSlab[i] = (std::uint32_t)wrap(node);
+		slabStart[particleSlab[i] + 1]++;
+	}
+	for (std::size_t s = 0; s < n; s++)
+	{
+		slabStart[s + 1] += slabStart[s];
+	}
+	std::vector<std::uint32_t> cursor(slabStart.begin(), slabStart.end() - 1);
+	for (std::size_t i = 0; i < count; i++)
+	{
+		slabParticles[cursor[particleSlab[i]]++] = (std::uint32_t)i;
+	}
+
+	// A particle in slab s writes slabs s and s + 1, so all even slabs can be filled at once, then all odd ones
+	for (std::size_t color = 0; color < 2; color++)
+	{
+		std::size_t slabs = (n - color + 1) / 2;
+		parallelFor(0, slabs, 1, [&](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t b = begin; b < end; b++)
+			{
+				std::size_t slab = 2 * b + color;
+				for (std::uint32_t p = slabStart[slab]; p < slabStart[slab + 1]; p++)
+				{
+					std::uint32_t i = slabParticles[p];
+					float mass = particles.mass[i];
+					if (mass == 0.0f)
+					{
+						continue;
+					}
+
+					int nx, ny, nz;
+					float fx, fy, fz;
+					cloudInCell(particles.x[i], originX, nx, fx);
+					cloudInCell(particles.y[i], originY, ny, fy);
+					cloudInCell(particles.z[i], originZ, nz, fz);
+
+					std::size_t xs[2] = { wrap(nx), wrap(nx + 1) };
+					std::size_t ys[2] = { wrap(ny), wrap(ny + 1) };
+					std::size_t zs[2] = { wrap(nz), wrap(nz + 1) };
+					float wx[2] = { 1.0f - fx, fx };
+					float wy[2] = { 1.0f - fy, fy };
+					float wz[2] = { 1.0f - fz, fz };
+
+					for (int a = 0; a < 2; a++)
+					{
+						for (int b2 = 0; b2 < 2; b2++)
+						{
+							for (int c = 0; c < 2; c++)
+							{
+								density[(xs[a] * n + ys[b2]) * n + zs[c]] += mass * wx[a] * wy[b2] * wz[c];
+							}
+						}
+					}
+				}
+			}
+		});
+	}
+}
+
+// --------------------- POISSON SOLVE ---------------------
+
+void PMGravity::solvePotential(float splitScale)
+{
+	std::size_t n = gridSize;
+	std::size_t m = fft.size();
+
+	std::fill(work.begin(), work.end(), Fft3d::Complex(0.0f, 0.0f));
+	parallelFor(0, n, 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+		{
+			for (std::size_t j = 0; j < n; j++)
+			{
+				for (std::size_t k = 0; k < n; k++)
+				{
+					work[(i * m + j) * m + k] = Fft3d::Complex(density[(i * n + j) * n + k], 0.0f);
+				}
+			}
+		}
+	});
+
+	fft.forward(work.data());
+
+	// Multiply by the Green's function, optionally filtered down to its long-range part.
+	// The filter removes the high frequencies, so it is safe to also divide out the CIC window (applied twice, assignment and interpolation).
+	const double waveScale = 2.0 * PI / ((double)m * cellSize);
+	auto window = [](double kh)
+	{
+		double half = 0.5 * kh;
+		double sinc = half == 0.0 ? 1.0 : std::sin(half) / half;
+		return sinc * sinc;
+	};
+	parallelFor(0, m, 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+		{
+			for (std::size_t j = 0; j < m; j++)
+			{
+				for (std::size_t k = 0; k < m; k++)
+				{
+					std::size_t index = (i * m + j) * m + k;
+					float filter = 1.0f;
+					if (splitScale > 0.0f)
+					{
+						double a = i < m / 2 ? (double)i : (double)i - (double)m;
+						double b = j < m / 2 ? (double)j : (double)j - (double)m;
+						double c = k < m / 2 ? (double)k : (double)k - (double)m;
+						double k2 = waveScale * waveScale * (a * a + b * b + c * c);
+						double h = cellSize;
+						double w = window(waveScale * a * h) * window(waveScale * b * h) * window(waveScale * c * h);
+						filter = (float)(std::exp(-k2 * splitScale * splitScale) / (w * w));
+					}
+					work[index] *= green[index] * filter;
+				}
+			}
+		}
+	});
+
+	fft.inverse(work.data());
+
+	// Undo the unnormalised inverse and scale the unit-cell Green's function to the real cell size
+	const float scale = (float)(GRAVITATIONAL_CONSTANT / (cellSize * (double)m * m * m));
+	parallelFor(0, n, 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+		{
+			for (std::size_t j = 0; j < n; j++)
+			{
+				for (std::size_t k = 0; k < n; k++)
+				{
+					potential[(i * n + j) * n + k] = work[(i * m + j) * m + k].real() * scale;
+				}
+			}
+		}
+	});
+}
+
+void PMGravity::differentiate()
+{
+	std::size_t n = gridSize;
+	const float inv12h = 1.0f / (12.0f * cellSize);
+
+	// a = -grad(potential) with the 4-point stencil (8 (p[+1] - p[-1]) - (p[+2] - p[-2])) / 12h
+	parallelFor(0, n, 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+		{
+			for (std::size_t j = 0; j < n; j++)
+			{
+				for (std::size_t k = 0; k < n; k++)
+				{
+					int x = (int)i, y = (int)j, z = (int)k;
+					auto p = [&](int a, int b, int c) { return potential[(wrap(a) * n + wrap(b)) * n + wrap(c)]; };
+					std::size_t index = (i * n + j) * n + k;
+
+					forceX[index] = -(8.0f * (p(x + 1, y, z) - p(x - 1, y, z)) - (p(x + 2, y, z) - p(x - 2, y, z))) * inv12h;
+					forceY[index] = -(8.0f * (p(x, y + 1, z) - p(x, y - 1, z)) - (p(x, y + 2, z) - p(x, y - 2, z))) * inv12h;
+					forceZ[index] = -(8.0f * (p(x, y, z + 1) - p(x, y, z - 1)) - (p(x, y, z + 2) - p(x, y, z - 2))) * inv12h;
+				}
+			}
+		}
+	});
+}
+
+// --------------------- FORCE INTERPOLATION ---------------------
+
+void PMGravity::interpolate(ParticleStore& particles) const
+{
+	std::size_t n = gridSize;
+
+	// Reads only from the meshes, every particle writes its own acceleration
+	parallelFor(0, particles.size(), 4096, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+		{
+			int nx, ny, nz;
+			float fx, fy, fz;
+			cloudInCell(particles.x[i], originX, nx, fx);
+			cloudInCell(particles.y[i], originY, ny, fy);
+			cloudInCell(particles.z[i], originZ, nz, fz);
+
+			std::size_t xs[2] = { wrap(nx), wrap(nx + 1) };
+			std::size_t ys[2] = { wrap(ny), wrap(ny + 1) };
+			std::size_t zs[2] = { wrap(nz), wrap(nz + 1) };
+			float wx[2] = { 1.0f - fx, fx };
+			float wy[2] = { 1.0f - fy, fy };
+			float wz[2] = { 1.0f - fz, fz };
+
+			float accX = 0.0f, accY = 0.0f, accZ = 0.0f;
+			for (int a = 0; a < 2; a++)
+			{
+				for (int b = 0; b < 2; b++)
+				{
+					for (int c = 0; c < 2; c++)
+					{
+						std::size_t index = (xs[a] * n + ys[b]) * n + zs[c];
+						float w = wx[a] * wy[b] * wz[c];
+						accX += forceX[index] * w;
+						accY += forceY[index] * w;
+						accZ += forceZ[index] * w;
+					}
+				}
+			}
+
+			particles.ax[i] += accX;
+			particles.ay[i] += accY;
+			particles.az[i] += accZ;
+		}
+	});
+}
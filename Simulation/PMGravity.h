@@ -0,0 +1,64 @@
+#ifndef PM_GRAVITY_H
+#define PM_GRAVITY_H
+
+#include <cstdint>
+#include <vector>
+
+#include "ForceSolver.h"
+#include "Fft.h"
+
+// Particle-Mesh gravity: masses are spread onto a gridSize^3 mesh with cloud-in-cell weights, Poisson's equation is solved with
+// an FFT, and the mesh forces (4-point finite differences of the potential) are interpolated back with the same weights.
+// Cost is O(N + G^3 log G) per step, independent of clustering, but forces are smoothed below a couple of cells.
+// With periodicBox = 0 the mesh follows the particles and uses zero padding for isolated boundaries,
+// otherwise the space is the periodic cube [0, periodicBox)^3.
+class PMGravity : public ForceSolver
+{
+	public:
+		// Cells per side, must be a power of two
+		unsigned int gridSize;
+		float periodicBox;
+
+		explicit PMGravity(unsigned int gridSize = 64, float periodicBox = 0.0f) : gridSize(gridSize), periodicBox(periodicBox), cachedSize(0), cachedPeriodic(false) {}
+
+		void computeAccelerations(ParticleStore& particles) override;
+		const char* name() const override { return "pm"; }
+
+		float meshCellSize() const { return cellSize; }
+
+	protected:
+		// Adds the mesh acceleration to ax/ay/az. splitCells > 0 keeps only the long-range part exp(-k^2 rs^2) of the force,
+		// with the split scale rs given in mesh cells, and removes the cloud-in-cell smoothing from what is left.
+		void addMeshAccelerations(ParticleStore& particles, float splitCells);
+
+		// Mesh geometry of the last evaluation
+		float cellSize;
+		float originX, originY, originZ;
+
+	private:
+		Fft3d fft;
+		// Mass per mesh node and the derived potential / force meshes, gridSize^3 each
+		std::vector<float> density, potential, forceX, forceY, forceZ;
+		// FFT work grid, (2 * gridSize)^3 for isolated boundaries
+		std::vector<Fft3d::Complex> work;
+		// Transformed Green's function for a unit cell size
+		std::vector<Fft3d::Complex> green;
+		unsigned int cachedSize;
+		bool cachedPeriodic;
+
+		// Particles binned by the x-slab of their lower CIC node
+		std::vector<std::uint32_t> slabStart, slabParticles;
+
+		void placeMesh(const ParticleStore& particles);
+		void buildGreen();
+		void deposit(const ParticleStore& particles);
+		void solvePotential(float splitScale);
+		void differentiate();
+		void interpolate(ParticleStore& particles) const;
+
+		// Lower CIC node and weight of the upper node along one axis
+		void cloudInCell(float position, float origin, int& node, float& weight) const;
+		std::size_t wrap(int node) const;
+};
+
+#endif
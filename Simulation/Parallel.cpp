@@ -0,0 +1,292 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------- WORK-STEALING POOL ---------------------
+// One deque of ranges per worker. A worker takes ranges from the back of its own deque and keeps halving them,
+// pushing the upper half back, until a single grain is left to run. Idle workers steal from the front of the other
+// deques, which is where the biggest remaining halves sit. Slot 0 belongs to whichever thread called parallelFor, the
+// pool threads own slots 1 .. workers - 1.
+
+namespace
+{
+	// One parallelFor call
+	struct Job
+	{
+		const std::function<void(std::size_t, std::size_t)>* body;
+		std::size_t grain;
+		// Items not yet finished, the caller returns when this reaches 0
+		std::atomic<std::size_t> remaining;
+	};
+
+	struct Range
+	{
+		Job* job;
+		std::size_t begin, end;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex lock;
+		std::deque<Range> ranges;
+	};
+
+	class ThreadPool
+	{
+		public:
+			ThreadPool() : queued(0), sleeping(0), stopping(false) {}
+			~ThreadPool() { stop(); }
+
+			void start(unsigned int workers);
+			void stop();
+			unsigned int size() const { return (unsigned int)queues.size(); }
+
+			void run(std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body);
+
+		private:
+			std::vector<std::unique_ptr<WorkerQueue>> queues;
+			std::vector<std::thread> threads;
+			// Ranges sitting in any deque, so sleeping workers know when to wake up
+			std::atomic<std::size_t> queued;
+			std::atomic<unsigned int> sleeping;
+			std::mutex sleepLock;
+			std::condition_variable wake;
+			bool stopping;
+
+			void push(unsigned int slot, const Range& range);
+			bool pop(unsigned int slot, Range& range);
+			bool steal(unsigned int slot, Range& range);
+			// Runs one range (splitting as it goes) taken from anywhere, returns false if every deque was empty
+			bool runOne(unsigned int slot);
+			void execute(unsigned int slot, Range range);
+			void workerLoop(unsigned int slot);
+	};
+
+	// Slot of the current thread in the pool, 0 for threads the pool did not start
+	thread_local unsigned int currentSlot = 0;
+}
+
+void ThreadPool::start(unsigned int workers)
+{
+	stop();
+
+	stopping = false;
+	for (unsigned int w = 0; w < workers; w++)
+	{
+		queues.emplace_back(new WorkerQueue());
+	}
+	for (unsigned int w = 1; w < workers; w++)
+	{
+		threads.emplace_back(&ThreadPool::workerLoop, this, w);
+	}
+}
+
+void ThreadPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	threads.clear();
+	queues.clear();
+}
+
+void ThreadPool::push(unsigned int slot, const Range& range)
+{
+	{
+		std::lock_guard<std::mutex> guard(queues[slot]->lock);
+		queues[slot]->ranges.push_back(range);
+	}
+	queued++;
+
+	if (sleeping > 0)
+	{
+		// Taking the lock orders this against a worker that has checked queued and is about to wait
+		std::lock_guard<std::mutex> guard(sleepLock);
+		wake.notify_one();
+	}
+}
+
+bool ThreadPool::pop(unsigned int slot, Range& range)
+{
+	std::lock_guard<std::mutex> guard(queues[slot]->lock);
+	std::deque<Range>& ranges = queues[slot]->ranges;
+	if (ranges.empty())
+	{
+		return false;
+	}
+
+	range = ranges.back();
+	ranges.pop_back();
+	queued--;
+	return true;
+}
+
+bool ThreadPool::steal(unsigned int slot, Range& range)
+{
+	unsigned int count = size();
+	for (unsigned int k = 1; k < count; k++)
+	{
+		WorkerQueue& victim = *queues[(slot + k) % count];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.ranges.empty())
+		{
+			range = victim.ranges.front();
+			victim.ranges.pop_front();
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ThreadPool::runOne(unsigned int slot)
+{
+	Range range;
+	if (pop(slot, range) || steal(slot, range))
+	{
+		execute(slot, range);
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::execute(unsigned int slot, Range range)
+{
+	Job& job = *range.job;
+
+	// Split on grain boundaries so chunks start at the same offsets no matter who runs them
+	for (;;)
+	{
+		std::size_t chunks = (range.end - range.begin + job.grain - 1) / job.grain;
+		if (chunks < 2)
+		{
+			break;
+		}
+		std::size_t middle = range.begin + chunks / 2 * job.grain;
+		push(slot, Range{ range.job, middle, range.end });
+		range.end = middle;
+	}
+
+	(*job.body)(range.begin, range.end);
+	job.remaining -= range.end - range.begin;
+}
+
+void ThreadPool::workerLoop(unsigned int slot)
+{
+	currentSlot = slot;
+
+	for (;;)
+	{
+		if (runOne(slot))
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(sleepLock);
+		sleeping++;
+		wake.wait(guard, [this]() { return stopping || queued > 0; });
+		sleeping--;
+		if (stopping)
+		{
+			return;
+		}
+	}
+}
+
+void ThreadPool::run(std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body)
+{
+	Job job;
+	job.body = &body;
+	job.grain = grain;
+	job.remaining = end - begin;
+
+	// Affinity hint: worker w starts on the w-th contiguous share of the range, so repeated loops over the same
+	// particles hand the same indices to the same threads and their caches stay warm
+	unsigned int slot = currentSlot;
+	std::size_t chunks = (end - begin + grain - 1) / grain;
+	std::size_t shares = std::min<std::size_t>(size(), chunks);
+	for (std::size_t s = shares; s-- > 0;)
+	{
+		std::size_t shareBegin = begin + chunks * s / shares * grain;
+		std::size_t shareEnd = std::min(end, begin + chunks * (s + 1) / shares * grain);
+		// Nested calls from inside a task keep everything on the calling worker and let the others steal
+		unsigned int target = slot == 0 ? (unsigned int)s : slot;
+		push(target, Range{ &job, shareBegin, shareEnd });
+	}
+
+	// Help out until every item is done, the job lives on this stack frame so nobody may still be running it
+	while (job.remaining > 0)
+	{
+		if (!runOne(slot))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+static ThreadPool pool;
+static std::mutex poolLock;
+// 0 until the first parallel loop or setThreadCount picks a count. Atomic because the first callers may race each other
+// and setThreadCount to fill it in.
+static std::atomic<unsigned int> workerCount(0);
+
+void setThreadCount(unsigned int count)
+{
+	std::lock_guard<std::mutex> guard(poolLock);
+	workerCount = count;
+	pool.stop();
+}
+
+unsigned int threadCount()
+{
+	unsigned int count = workerCount.load();
+	if (count == 0)
+	{
+		// Only fills in the default, a count set meanwhile by setThreadCount wins
+		unsigned int fallback = std::max(1u, std::thread::hardware_concurrency());
+		if (workerCount.compare_exchange_strong(count, fallback) || count == 0)
+		{
+			count = fallback;
+		}
+	}
+	return count;
+}
+
+void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body)
+{
+	if (end <= begin)
+	{
+		return;
+	}
+
+	grain = std::max<std::size_t>(grain, 1);
+	if (threadCount() <= 1 || end - begin <= grain)
+	{
+		body(begin, end);
+		return;
+	}
+
+	// Started on first use (and again after setThreadCount) rather than at static initialisation
+	{
+		std::lock_guard<std::mutex> guard(poolLock);
+		if (pool.size() != threadCount())
+		{
+			pool.start(threadCount());
+		}
+	}
+	pool.run(begin, end, grain, body);
+}
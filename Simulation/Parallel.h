@@ -0,0 +1,61 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Number of worker threads the solvers split their loops across (defaults to the hardware thread count).
+// The workers are started on the first parallel loop and restarted after a change; don't call this from inside a loop.
+void setThreadCount(unsigned int count);
+unsigned int threadCount();
+
+// Splits [begin, end) into chunks of grain items (the last one may be shorter) and calls body(chunkBegin, chunkEnd)
+// for each one on a persistent work-stealing pool of threadCount() threads, the calling thread included. Each worker
+// starts on its own contiguous share of the range and idle workers steal the largest untouched halves from the others,
+// so uneven chunks (deep tree walks) balance out. Chunk boundaries are always begin + k * grain, whichever thread runs
+// them. Loops may be nested: a body can call parallelFor and its worker helps with the inner loop until it is done.
+// Returns once every chunk has finished.
+void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body);
+
+// Reproducibility contract: every loop in the simulation core gives each output element to exactly one chunk and
+// accumulates it in a fixed order, and chunk boundaries only depend on grain, so results are bit-identical for any
+// thread count and any scheduling. Sums across chunks must go through parallelReduce below rather than a shared
+// accumulator.
+
+// Deterministic parallel reduction: body(chunkBegin, chunkEnd) returns the value for one chunk of parallelFor's
+// chunking, and the chunk values are combined with combine(left, right) along a fixed pairwise tree over the chunk
+// indices. The result is bit-identical whatever the thread count, and the pairwise tree also keeps the rounding error
+// of long floating point sums down to O(log chunks).
+template <class T, class Body, class Combine>
+T parallelReduce(std::size_t begin, std::size_t end, std::size_t grain, const T& identity, const Body& body, const Combine& combine)
+{
+	if (end <= begin)
+	{
+		return identity;
+	}
+
+	grain = grain > 0 ? grain : 1;
+	std::size_t chunks = (end - begin + grain - 1) / grain;
+	std::vector<T> partials(chunks, identity);
+	parallelFor(begin, end, grain, [&](std::size_t chunkBegin, std::size_t chunkEnd)
+	{
+		// A chunk handed over whole may span several grains, each grain still gets its own slot
+		for (std::size_t b = chunkBegin; b < chunkEnd; b += grain)
+		{
+			partials[(b - begin) / grain] = body(b, std::min(b + grain, chunkEnd));
+		}
+	});
+
+	for (std::size_t width = 1; width < chunks; width *= 2)
+	{
+		for (std::size_t i = 0; i + width < chunks; i += 2 * width)
+		{
+			partials[i] = combine(partials[i], partials[i + width]);
+		}
+	}
+	return partials[0];
+}
+
+#endif
@@ -0,0 +1,236 @@
+#include "ParticleStore.h"
+
+#include <algorithm>
+
+#include "Parallel.h"
+
+// Particles per chunk of the whole-array kick and drift
+static const std::size_t UPDATE_GRAIN = 16384;
+
+std::size_t ParticleStore::add(float px, float py, float pz, float pvx, float pvy, float pvz, float m)
+{
+	std::size_t i = count;
+	resize(count + 1);
+
+	x[i] = px;
+	y[i] = py;
+	z[i] = pz;
+	vx[i] = pvx;
+	vy[i] = pvy;
+	vz[i] = pvz;
+	mass[i] = m;
+
+	if (precise)
+	{
+		preciseX[i] = px;
+		preciseY[i] = py;
+		preciseZ[i] = pz;
+		preciseVx[i] = pvx;
+		preciseVy[i] = pvy;
+		preciseVz[i] = pvz;
+	}
+
+	return i;
+}
+
+void ParticleStore::resize(std::size_t n)
+{
+	std::size_t length = padded(n);
+	AlignedVector<float>* arrays[] = { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass };
+
+	for (AlignedVector<float>* a : arrays)
+	{
+		a->resize(length, 0.0f);
+		// Entries between the new count and the padded end must read as empty particles again
+		if (n < count)
+		{
+			std::fill(a->begin() + n, a->end(), 0.0f);
+		}
+	}
+
+	if (precise)
+	{
+		AlignedVector<double>* preciseArrays[] = { &preciseX, &preciseY, &preciseZ, &preciseVx, &preciseVy, &preciseVz, &carryX, &carryY, &carryZ };
+		for (AlignedVector<double>* a : preciseArrays)
+		{
+			a->resize(length, 0.0);
+			if (n < count)
+			{
+				std::fill(a->begin() + n, a->end(), 0.0);
+			}
+		}
+	}
+
+	ids.resize(n);
+	for (std::size_t i = count; i < n; i++)
+	{
+		ids[i] = nextId++;
+	}
+
+	count = n;
+}
+
+void ParticleStore::reserve(std::size_t n)
+{
+	std::size_t length = padded(n);
+	AlignedVector<float>* arrays[] = { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass };
+
+	for (AlignedVector<float>* a : arrays)
+	{
+		a->reserve(length);
+	}
+}
+
+// Rearranges the first order.size() entries of values so values[k] = old values[order[k]]
+template <class T>
+static void gather(AlignedVector<T>& values, const std::vector<std::uint32_t>& order, AlignedVector<T>& scratch)
+{
+	scratch = values;
+	parallelFor(0, order.size(), UPDATE_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t k = begin; k < end; k++)
+		{
+			values[k] = scratch[order[k]];
+		}
+	});
+}
+
+void ParticleStore::permute(const std::vector<std::uint32_t>& order)
+{
+	AlignedVector<float> scratch;
+	AlignedVector<float>* arrays[] = { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass };
+	for (AlignedVector<float>* a : arrays)
+	{
+		gather(*a, order, scratch);
+	}
+
+	if (precise)
+	{
+		AlignedVector<double> preciseScratch;
+		AlignedVector<double>* preciseArrays[] = { &preciseX, &preciseY, &preciseZ, &preciseVx, &preciseVy, &preciseVz, &carryX, &carryY, &carryZ };
+		for (AlignedVector<double>* a : preciseArrays)
+		{
+			gather(*a, order, preciseScratch);
+		}
+	}
+
+	std::vector<std::uint32_t> oldIds = ids;
+	for (std::size_t k = 0; k < order.size(); k++)
+	{
+		ids[k] = oldIds[order[k]];
+	}
+}
+
+void ParticleStore::clearAccelerations()
+{
+	std::fill(ax.begin(), ax.end(), 0.0f);
+	std::fill(ay.begin(), ay.end(), 0.0f);
+	std::fill(az.begin(), az.end(), 0.0f);
+}
+
+void ParticleStore::setMixedPrecision(bool enabled)
+{
+	precise = enabled;
+
+	AlignedVector<double>* preciseArrays[] = { &preciseX, &preciseY, &preciseZ, &preciseVx, &preciseVy, &preciseVz, &carryX, &carryY, &carryZ };
+	for (AlignedVector<double>* a : preciseArrays)
+	{
+		a->assign(enabled ? x.size() : 0, 0.0);
+	}
+
+	if (enabled)
+	{
+		std::copy(x.begin(), x.end(), preciseX.begin());
+		std::copy(y.begin(), y.end(), preciseY.begin());
+		std::copy(z.begin(), z.end(), preciseZ.begin());
+		std::copy(vx.begin(), vx.end(), preciseVx.begin());
+		std::copy(vy.begin(), vy.end(), preciseVy.begin());
+		std::copy(vz.begin(), vz.end(), preciseVz.begin());
+	}
+}
+
+// Replaces the double value (and drops its carry) only where the float no longer matches it, so particles that were
+// not touched keep their extra precision
+static inline void refreshComponent(float value, double& preciseValue)
+{
+	if ((float)preciseValue != value)
+	{
+		preciseValue = value;
+	}
+}
+
+void ParticleStore::refreshPreciseState()
+{
+	if (!precise)
+	{
+		return;
+	}
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		if ((float)preciseX[i] != x[i] || (float)preciseY[i] != y[i] || (float)preciseZ[i] != z[i])
+		{
+			preciseX[i] = x[i];
+			preciseY[i] = y[i];
+			preciseZ[i] = z[i];
+			carryX[i] = carryY[i] = carryZ[i] = 0.0;
+		}
+		refreshComponent(vx[i], preciseVx[i]);
+		refreshComponent(vy[i], preciseVy[i]);
+		refreshComponent(vz[i], preciseVz[i]);
+	}
+}
+
+void ParticleStore::kick(float h)
+{
+	parallelFor(0, count, UPDATE_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		if (!precise)
+		{
+			for (std::size_t i = begin; i < end; i++)
+			{
+				vx[i] += ax[i] * h;
+				vy[i] += ay[i] * h;
+				vz[i] += az[i] * h;
+			}
+			return;
+		}
+
+		for (std::size_t i = begin; i < end; i++)
+		{
+			preciseVx[i] += (double)ax[i] * h;
+			preciseVy[i] += (double)ay[i] * h;
+			preciseVz[i] += (double)az[i] * h;
+			vx[i] = (float)preciseVx[i];
+			vy[i] = (float)preciseVy[i];
+			vz[i] = (float)preciseVz[i];
+		}
+	});
+}
+
+void ParticleStore::drift(float h)
+{
+	parallelFor(0, count, UPDATE_GRAIN, [&](std::size_t begin, std::size_t end)
+	{
+		if (!precise)
+		{
+			for (std::size_t i = begin; i < end; i++)
+			{
+				x[i] += vx[i] * h;
+				y[i] += vy[i] * h;
+				z[i] += vz[i] * h;
+			}
+			return;
+		}
+
+		for (std::size_t i = begin; i < end; i++)
+		{
+			compensatedAdd(preciseX[i], carryX[i], preciseVx[i] * h);
+			compensatedAdd(preciseY[i], carryY[i], preciseVy[i] * h);
+			compensatedAdd(preciseZ[i], carryZ[i], preciseVz[i] * h);
+			x[i] = (float)preciseX[i];
+			y[i] = (float)preciseY[i];
+			z[i] = (float)preciseZ[i];
+		}
+	});
+}
@@ -0,0 +1,131 @@
+#ifndef PARTICLE_STORE_H
+#define PARTICLE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+
+// Every array is padded to a multiple of this many entries so SIMD kernels can always load full registers.
+// Padding entries have zero mass and sit at the origin.
+const std::size_t PARTICLE_PADDING = 16;
+
+// Structure-of-arrays particle container. Each component lives in its own aligned array so force kernels
+// and integrators can stream through them with vector loads instead of gathering from glm::vec3s.
+class ParticleStore
+{
+	public:
+		// Positions
+		AlignedVector<float> x, y, z;
+		// Velocities
+		AlignedVector<float> vx, vy, vz;
+		// Accelerations written by the force solvers
+		AlignedVector<float> ax, ay, az;
+		AlignedVector<float> mass;
+
+		// Mixed-precision state, empty unless setMixedPrecision(true). Positions and velocities are then kept in double
+		// and x..vz hold the same values rounded to float, which is all the force kernels read.
+		AlignedVector<double> preciseX, preciseY, preciseZ;
+		AlignedVector<double> preciseVx, preciseVy, preciseVz;
+		// Low-order bits lost by each position update, fed back into the next one (Kahan summation)
+		AlignedVector<double> carryX, carryY, carryZ;
+		// Stable identity of the particle in each slot (one entry per real particle). Particles get 0, 1, 2, ... in the
+		// order they are added and keep their id when permute() moves them, so anyone tracking a particle across a
+		// reorder looks it up by id rather than by index.
+		std::vector<std::uint32_t> ids;
+
+		ParticleStore() : count(0), precise(false), nextId(0) {}
+
+		// Number of real particles (excluding padding)
+		std::size_t size() const { return count; }
+		// Length of every array, always a multiple of PARTICLE_PADDING
+		std::size_t paddedSize() const { return x.size(); }
+		bool empty() const { return count == 0; }
+
+		// Appends a particle and returns its index
+		std::size_t add(float px, float py, float pz, float pvx, float pvy, float pvz, float m);
+
+		// Grows or shrinks to n particles, new particles are zeroed
+		void resize(std::size_t n);
+		void reserve(std::size_t n);
+		void clear() { resize(0); }
+
+		// Moves the particle in slot order[k] to slot k for every k < size(), carrying every array (accelerations, the
+		// mixed-precision state and ids included) along. order must be a permutation of 0 .. size() - 1.
+		void permute(const std::vector<std::uint32_t>& order);
+
+		// Zeroes the acceleration arrays before a force evaluation
+		void clearAccelerations();
+
+		// Switches the double-precision position and velocity copies on (initialised from the float arrays) or off
+		void setMixedPrecision(bool enabled);
+		bool mixedPrecision() const { return precise; }
+
+		// Picks up particles whose float position or velocity was written directly (by hand or by an integrator that
+		// keeps its own state) since the double copy was last rounded into them. Does nothing without mixed precision.
+		void refreshPreciseState();
+
+		// v += a * h for one particle or for all of them, in double when mixed precision is on
+		void kick(std::size_t i, float h);
+		void kick(float h);
+		// x += v * h for one particle or for all of them, in double with compensated summation when mixed precision is on
+		void drift(std::size_t i, float h);
+		void drift(float h);
+
+	private:
+		std::size_t count;
+		bool precise;
+		std::uint32_t nextId;
+
+		static std::size_t padded(std::size_t n) { return (n + PARTICLE_PADDING - 1) / PARTICLE_PADDING * PARTICLE_PADDING; }
+};
+
+// Kahan step: adds delta to sum, carrying the rounding error of each addition over to the next one
+inline void compensatedAdd(double& sum, double& carry, double delta)
+{
+	double corrected = delta - carry;
+	double next = sum + corrected;
+	carry = (next - sum) - corrected;
+	sum = next;
+}
+
+inline void ParticleStore::kick(std::size_t i, float h)
+{
+	if (precise)
+	{
+		preciseVx[i] += (double)ax[i] * h;
+		preciseVy[i] += (double)ay[i] * h;
+		preciseVz[i] += (double)az[i] * h;
+		vx[i] = (float)preciseVx[i];
+		vy[i] = (float)preciseVy[i];
+		vz[i] = (float)preciseVz[i];
+	}
+	else
+	{
+		vx[i] += ax[i] * h;
+		vy[i] += ay[i] * h;
+		vz[i] += az[i] * h;
+	}
+}
+
+inline void ParticleStore::drift(std::size_t i, float h)
+{
+	if (precise)
+	{
+		compensatedAdd(preciseX[i], carryX[i], preciseVx[i] * h);
+		compensatedAdd(preciseY[i], carryY[i], preciseVy[i] * h);
+		compensatedAdd(preciseZ[i], carryZ[i], preciseVz[i] * h);
+		x[i] = (float)preciseX[i];
+		y[i] = (float)preciseY[i];
+		z[i] = (float)preciseZ[i];
+	}
+	else
+	{
+		x[i] += vx[i] * h;
+		y[i] += vy[i] * h;
+		z[i] += vz[i] * h;
+	}
+}
+
+#endif
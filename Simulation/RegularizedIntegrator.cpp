@@ -0,0 +1,161 @@
+#include "RegularizedIntegrator.h"
+
+#include <cmath>
+
+#include "KustaanheimoStiefel.h"
+#include "Parallel.h"
+
+// Particles per chunk of the kick sweep
+static const std::size_t KICK_GRAIN = 4096;
+
+// Pull of a range of particles on the sun
+struct SunPull
+{
+	double x, y, z;
+};
+
+static SunPull addPulls(const SunPull& a, const SunPull& b)
+{
+	return { a.x + b.x, a.y + b.y, a.z + b.z };
+}
+
+void RegularizedIntegrator::mutualAccelerations(ParticleStore& particles, ForceSolver& solver)
+{
+	float sun = particles.mass[0];
+	particles.mass[0] = 0.0f;
+	solver.computeAccelerations(particles);
+	particles.mass[0] = sun;
+
+	forceEvaluations += particles.size();
+}
+
+void RegularizedIntegrator::kick(ParticleStore& particles, double dt)
+{
+	std::size_t n = particles.size();
+	double mu = GRAVITATIONAL_CONSTANT * particles.mass[0];
+	double sunX = particles.x[0], sunY = particles.y[0], sunZ = particles.z[0];
+
+	// Particle 0 is the sun itself, its own kick comes from the summed pulls below
+	SunPull zero = {};
+	SunPull pull = parallelReduce(1, n, KICK_GRAIN, zero, [&](std::size_t begin, std::size_t end)
+	{
+		SunPull chunk = {};
+		for (std::size_t i = begin; i < end; i++)
+		{
+			if (inEncounter[i])
+			{
+				continue;
+			}
+
+			double dx = particles.x[i] - sunX;
+			double dy = particles.y[i] - sunY;
+			double dz = particles.z[i] - sunZ;
+			double r2 = dx * dx + dy * dy + dz * dz;
+			double invR3 = r2 > 0.0 ? 1.0 / (r2 * std::sqrt(r2)) : 0.0;
+
+			particles.vx[i] += (float)((particles.ax[i] - mu * dx * invR3) * dt);
+			particles.vy[i] += (float)((particles.ay[i] - mu * dy * invR3) * dt);
+			particles.vz[i] += (float)((particles.az[i] - mu * dz * invR3) * dt);
+
+			double s = GRAVITATIONAL_CONSTANT * particles.mass[i] * invR3;
+			chunk.x += dx * s;
+			chunk.y += dy * s;
+			chunk.z += dz * s;
+		}
+		return chunk;
+	}, addPulls);
+	sunAx = pull.x;
+	sunAy = pull.y;
+	sunAz = pull.z;
+
+	particles.vx[0] += (float)(sunAx * dt);
+	particles.vy[0] += (float)(sunAy * dt);
+	particles.vz[0] += (float)(sunAz * dt);
+}
+
+void RegularizedIntegrator::step(ParticleStore& particles, ForceSolver& solver, float dt)
+{
+	std::size_t n = particles.size();
+	if (n == 0)
+	{
+		return;
+	}
+
+	// The accelerations of the closing kick are still valid for the opening kick of the next step
+	if (!primed || inEncounter.size() != n)
+	{
+		mutualAccelerations(particles, solver);
+		primed = true;
+	}
+
+	// Encounters are decided once per step so both kicks skip the same particles
+	double mu = GRAVITATIONAL_CONSTANT * particles.mass[0];
+	double radius2 = (double)encounterRadius * encounterRadius;
+	inEncounter.assign(n, 0);
+	encounters.clear();
+	relative.clear();
+	for (std::size_t i = 1; i < n && mu > 0.0; i++)
+	{
+		double dx = particles.x[i] - particles.x[0];
+		double dy = particles.y[i] - particles.y[0];
+		double dz = particles.z[i] - particles.z[0];
+		if (dx * dx + dy * dy + dz * dz < radius2)
+		{
+			inEncounter[i] = 1;
+			encounters.push_back((std::uint32_t)i);
+			relative.push_back(dx);
+			relative.push_back(dy);
+			relative.push_back(dz);
+			relative.push_back(particles.vx[i] - particles.vx[0]);
+			relative.push_back(particles.vy[i] - particles.vy[0]);
+			relative.push_back(particles.vz[i] - particles.vz[0]);
+		}
+	}
+
+	kick(particles, 0.5 * dt);
+
+	// Relative to the sun, a particle in an encounter feels its mutual forces minus the sun's acceleration
+	perturbation.resize(3 * encounters.size());
+	for (std::size_t k = 0; k < encounters.size(); k++)
+	{
+		std::uint32_t i = encounters[k];
+		perturbation[3 * k] = particles.ax[i] - sunAx;
+		perturbation[3 * k + 1] = particles.ay[i] - sunAy;
+		perturbation[3 * k + 2] = particles.az[i] - sunAz;
+	}
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		if (!inEncounter[i])
+		{
+			particles.x[i] += particles.vx[i] * dt;
+			particles.y[i] += particles.vy[i] * dt;
+			particles.z[i] += particles.vz[i] * dt;
+		}
+	}
+
+	for (std::size_t k = 0; k < encounters.size(); k++)
+	{
+		std::uint32_t i = encounters[k];
+		double* state = &relative[6 * k];
+		regularizedSteps += ksPropagate(state, state + 3, mu, &perturbation[3 * k], dt, stepsPerOrbit);
+		particles.x[i] = (float)(particles.x[0] + state[0]);
+		particles.y[i] = (float)(particles.y[0] + state[1]);
+		particles.z[i] = (float)(particles.z[0] + state[2]);
+	}
+	encounterSteps += encounters.size();
+
+	mutualAccelerations(particles, solver);
+	kick(particles, 0.5 * dt);
+
+	// Velocities relative to the sun carry the sun's acceleration with a minus sign, adding the sun's velocity after
+	// its closing kick gives each particle its full mutual acceleration over the step
+	for (std::size_t k = 0; k < encounters.size(); k++)
+	{
+		std::uint32_t i = encounters[k];
+		const double* state = &relative[6 * k];
+		particles.vx[i] = (float)(particles.vx[0] + state[3]);
+		particles.vy[i] = (float)(particles.vy[0] + state[4]);
+		particles.vz[i] = (float)(particles.vz[0] + state[5]);
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef REGULARIZED_INTEGRATOR_H
+#define REGULARIZED_INTEGRATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Integrator.h"
+
+// Kick-drift-kick leapfrog that regularises close encounters with the particle at index 0 (the sun). Away from the
+// sun a particle is kicked with the solver's mutual forces plus the sun's exact pull. Inside encounterRadius its
+// motion relative to the sun is handed to ksPropagate for the whole step, with the mutual forces and the sun's own
+// acceleration folded in as a constant perturbation, so pericentre passages of any depth (head-on included) keep their
+// energy instead of being thrown out by one huge kick at the wrong moment.
+// During an encounter a particle is a test particle of the sun: its pull on the sun is left out, which is exact for
+// massless particles and an O(m / M) error otherwise. The sun's pull is never softened, solver softening only applies
+// to the mutual forces.
+class RegularizedIntegrator : public Integrator
+{
+	public:
+		// Distance from the sun inside which a particle's step is regularised
+		float encounterRadius;
+		// Regularised steps per revolution of an encounter orbit
+		unsigned int stepsPerOrbit;
+
+		explicit RegularizedIntegrator(float encounterRadius = 5.0f, unsigned int stepsPerOrbit = 256)
+			: encounterRadius(encounterRadius), stepsPerOrbit(stepsPerOrbit), encounterSteps(0), regularizedSteps(0), primed(false) {}
+
+		void step(ParticleStore& particles, ForceSolver& solver, float dt) override;
+		void reset() override { primed = false; }
+		const char* name() const override { return "regularized"; }
+
+		// Particle steps taken inside the encounter radius so far, and the regularised substeps they needed
+		std::uint64_t encounterSteps, regularizedSteps;
+
+	private:
+		bool primed;
+		// Particles inside the encounter radius at the start of the current step
+		std::vector<std::uint32_t> encounters;
+		std::vector<std::uint8_t> inEncounter;
+		// Position and velocity relative to the sun (6 per encounter), then the perturbing acceleration (3 per encounter)
+		std::vector<double> relative, perturbation;
+		// Sun's acceleration from the particles outside the encounter radius, as used by the last kick
+		double sunAx, sunAy, sunAz;
+
+		// Mutual accelerations at the current positions, left in particles.ax/ay/az
+		void mutualAccelerations(ParticleStore& particles, ForceSolver& solver);
+		// Kicks every particle outside the encounter radius, and the sun, by dt
+		void kick(ParticleStore& particles, double dt);
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "Scenario.h"
+
+#include <cmath>
+#include <random>
+
+#include "ForceSolver.h"
+
+void buildDefaultScenario(ParticleStore& particles, std::size_t count)
+{
+	particles.clear();
+	particles.reserve(count);
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		float f = (float)i;
+
+		if (i > 1000)
+		{
+			f = ((float)i / 1000) + 5.0f;
+		}
+
+		if (i > 100)
+		{
+			f = ((float)i / 100) + 5.0f;
+		}
+
+		if (f > 50)
+		{
+			f = 100 - f + 1.5f;
+		}
+
+		if (i % 2 == 0)
+		{
+			f *= -1;
+		}
+
+		if (i == 0)
+		{
+			// Sun's coordinate is index 0 and it starts at rest
+			particles.add(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, SUN_MASS);
+		}
+		else
+		{
+			particles.add(50 * std::sin(f), 50 * std::cos(f), 0.0f, std::sqrt(0.5f), 0.0f, 0.0f, 0.0f);
+		}
+	}
+}
+
+void buildDiskScenario(ParticleStore& particles, std::size_t count, float diskMass, unsigned int seed)
+{
+	const float innerRadius = 10.0f;
+	const float outerRadius = 60.0f;
+	const float thickness = 1.0f;
+	const float twoPi = 6.28318530718f;
+
+	particles.clear();
+	particles.reserve(count);
+	particles.add(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, SUN_MASS);
+
+	if (count < 2)
+	{
+		return;
+	}
+
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+	float particleMass = diskMass / (count - 1);
+
+	for (std::size_t i = 1; i < count; i++)
+	{
+		// Uniform surface density between the inner and outer radius
+		float u = dis(gen);
+		float r = std::sqrt(innerRadius * innerRadius + u * (outerRadius * outerRadius - innerRadius * innerRadius));
+		float angle = twoPi * dis(gen);
+		float height = thickness * (dis(gen) - 0.5f);
+
+		// Circular speed around the sun plus the disk mass inside r
+		float enclosed = SUN_MASS + diskMass * u;
+		float speed = std::sqrt(GRAVITATIONAL_CONSTANT * enclosed / r);
+
+		particles.add(r * std::cos(angle), r * std::sin(angle), height,
+			-speed * std::sin(angle), speed * std::cos(angle), 0.0f, particleMass);
+	}
+}
+
+void buildDebrisDiskScenario(ParticleStore& particles, std::size_t count, unsigned int planets, unsigned int seed)
+{
+	const float innerRadius = 15.0f;
+	const float outerRadius = 100.0f;
+	const float thickness = 0.5f;
+	const float twoPi = 6.28318530718f;
+	// Mass and orbit spacing of the planets, the innermost at firstOrbit and each next one orbitSpacing times further out
+	const float planetMass = 0.05f;
+	const float firstOrbit = 25.0f;
+	const float orbitSpacing = 1.5f;
+
+	particles.clear();
+	particles.reserve(count);
+	if (count == 0)
+	{
+		return;
+	}
+	particles.add(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, SUN_MASS);
+
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+
+	float orbit = firstOrbit;
+	for (unsigned int p = 0; p < planets && particles.size() < count; p++)
+	{
+		float angle = twoPi * dis(gen);
+		float speed = std::sqrt(GRAVITATIONAL_CONSTANT * SUN_MASS / orbit);
+		particles.add(orbit * std::cos(angle), orbit * std::sin(angle), 0.0f,
+			-speed * std::sin(angle), speed * std::cos(angle), 0.0f, planetMass);
+		orbit *= orbitSpacing;
+	}
+
+	while (particles.size() < count)
+	{
+		// Uniform surface density between the inner and outer radius
+		float u = dis(gen);
+		float r = std::sqrt(innerRadius * innerRadius + u * (outerRadius * outerRadius - innerRadius * innerRadius));
+		float angle = twoPi * dis(gen);
+		float height = thickness * (dis(gen) - 0.5f);
+		float speed = std::sqrt(GRAVITATIONAL_CONSTANT * SUN_MASS / r);
+
+		particles.add(r * std::cos(angle), r * std::sin(angle), height,
+			-speed * std::sin(angle), speed * std::cos(angle), 0.0f, 0.0f);
+	}
+}
+
+void buildUniformScenario(ParticleStore& particles, std::size_t count, float radius, float totalMass, unsigned int seed)
+{
+	particles.clear();
+	particles.reserve(count);
+
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+	float particleMass = count > 0 ? totalMass / count : 0.0f;
+
+	while (particles.size() < count)
+	{
+		// Rejection sample the unit ball
+		float x = dis(gen), y = dis(gen), z = dis(gen);
+		if (x * x + y * y + z * z > 1.0f)
+		{
+			continue;
+		}
+		particles.add(radius * x, radius * y, radius * z, 0.0f, 0.0f, 0.0f, particleMass);
+	}
+}
+
+void buildPlummerScenario(ParticleStore& particles, std::size_t count, float totalMass, float scaleRadius, unsigned int seed)
+{
+	const double twoPi = 6.28318530717958647692;
+
+	particles.clear();
+	particles.reserve(count);
+	if (count == 0)
+	{
+		return;
+	}
+
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<double> dis(0.0, 1.0);
+	float particleMass = totalMass / count;
+	double velocityScale = std::sqrt(GRAVITATIONAL_CONSTANT * totalMass / scaleRadius);
+
+	// Uniform direction scaled to length
+	auto direction = [&](double length, double& x, double& y, double& z)
+	{
+		double cosTheta = 2.0 * dis(gen) - 1.0;
+		double sinTheta = std::sqrt(1.0 - cosTheta * cosTheta);
+		double phi = twoPi * dis(gen);
+		x = length * sinTheta * std::cos(phi);
+		y = length * sinTheta * std::sin(phi);
+		z = length * cosTheta;
+	};
+
+	double sumX = 0.0, sumY = 0.0, sumZ = 0.0, sumVX = 0.0, sumVY = 0.0, sumVZ = 0.0;
+	while (particles.size() < count)
+	{
+		// Radius from the inverted cumulative mass, cut at 20 scale radii so a few stars do not end up far away
+		double u = dis(gen);
+		if (u <= 0.0)
+		{
+			continue;
+		}
+		double r = 1.0 / std::sqrt(std::pow(u, -2.0 / 3.0) - 1.0);
+		if (r > 20.0)
+		{
+			continue;
+		}
+
+		// Speed as a fraction q of the local escape speed, rejection sampled from q^2 (1 - q^2)^3.5
+		double q, g;
+		do
+		{
+			q = dis(gen);
+			g = 0.1 * dis(gen);
+		} while (g > q * q * std::pow(1.0 - q * q, 3.5));
+		double speed = q * std::sqrt(2.0) * std::pow(1.0 + r * r, -0.25);
+
+		double x, y, z, vx, vy, vz;
+		direction(r * scaleRadius, x, y, z);
+		direction(speed * velocityScale, vx, vy, vz);
+		particles.add((float)x, (float)y, (float)z, (float)vx, (float)vy, (float)vz, particleMass);
+
+		sumX += x;
+		sumY += y;
+		sumZ += z;
+		sumVX += vx;
+		sumVY += vy;
+		sumVZ += vz;
+	}
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		particles.x[i] -= (float)(sumX / count);
+		particles.y[i] -= (float)(sumY / count);
+		particles.z[i] -= (float)(sumZ / count);
+		particles.vx[i] -= (float)(sumVX / count);
+		particles.vy[i] -= (float)(sumVY / count);
+		particles.vz[i] -= (float)(sumVZ / count);
+	}
+}
@@ -0,0 +1,32 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <cstddef>
+
+#include "ParticleStore.h"
+
+// Mass of the sun in the default scenario (the old gravity() strength of -50)
+const float SUN_MASS = 50.0f;
+
+// Replaces the contents of particles with the original demo: a sun at the origin (index 0)
+// and count - 1 massless particles on a ring of radius 50 all starting with the same sideways velocity.
+void buildDefaultScenario(ParticleStore& particles, std::size_t count);
+
+// Sun at the origin surrounded by a thin self-gravitating disk of count - 1 particles sharing diskMass,
+// each started on a roughly circular orbit. Used to exercise the mutual gravity solvers.
+void buildDiskScenario(ParticleStore& particles, std::size_t count, float diskMass = 5.0f, unsigned int seed = 1);
+
+// Sun at the origin, a few planets on circular orbits and count - 1 - planets massless grains in a thin disk between
+// them, each on a circular orbit around the sun. Planets and sun are the only massive bodies, the layout
+// MassiveBodyGravity is built for.
+void buildDebrisDiskScenario(ParticleStore& particles, std::size_t count, unsigned int planets = 4, unsigned int seed = 1);
+
+// count equal-mass particles spread uniformly through a sphere of the given radius, all at rest (a cold collapse).
+// No sun, the smooth mass distribution the mesh solvers are built for.
+void buildUniformScenario(ParticleStore& particles, std::size_t count, float radius = 50.0f, float totalMass = 50.0f, unsigned int seed = 1);
+
+// Plummer sphere of count equal-mass stars with scale radius a, in virial equilibrium (Aarseth, Henon & Wielen 1974
+// sampling), moved to the centre-of-mass frame. No sun, the dense collisional system the Hermite integrator is for.
+void buildPlummerScenario(ParticleStore& particles, std::size_t count, float totalMass = 50.0f, float scaleRadius = 10.0f, unsigned int seed = 1);
+
+#endif
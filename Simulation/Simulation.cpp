@@ -0,0 +1,42 @@
+#include "Simulation.h"
+
+#include "CentralGravity.h"
+#include "EulerIntegrator.h"
+#include "MortonOrder.h"
+
+Simulation::Simulation() : time(0.0), reorderInterval(0), solver(new CentralGravity()), stepper(new EulerIntegrator()), stepsSinceReorder(0)
+{
+}
+
+void Simulation::setForceSolver(std::unique_ptr<ForceSolver> newSolver)
+{
+	solver = std::move(newSolver);
+	stepper->reset();
+}
+
+void Simulation::setIntegrator(std::unique_ptr<Integrator> newIntegrator)
+{
+	stepper = std::move(newIntegrator);
+}
+
+bool Simulation::reorderIfDue()
+{
+	if (reorderInterval == 0 || stepsSinceReorder < reorderInterval)
+	{
+		return false;
+	}
+
+	stepsSinceReorder = 0;
+	sortByMorton(particles);
+	stepper->particlesReordered();
+	return true;
+}
+
+void Simulation::step(float dt)
+{
+	reorderIfDue();
+	particles.refreshPreciseState();
+	stepper->step(particles, *solver, dt);
+	stepsSinceReorder++;
+	time += dt;
+}
@@ -0,0 +1,48 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <memory>
+
+#include "ParticleStore.h"
+#include "ForceSolver.h"
+#include "Integrator.h"
+
+// Owns the particles and advances them. Knows nothing about windows or OpenGL so it can run on render-less machines.
+class Simulation
+{
+	public:
+		ParticleStore particles;
+		// Simulated time since the start
+		double time;
+		// Steps between re-sorts of the particles along a Z-order curve (sun left at index 0), 0 never re-sorts.
+		// Particles drift apart in memory as they move; sorting them back keeps tree walks cache friendly. Integrators
+		// that keep per-index state of their own rebuild it on the next step. Use ParticleStore::ids to follow a
+		// particle across re-sorts.
+		unsigned int reorderInterval;
+
+		// Starts with the sun-only CentralGravity solver and semi-implicit Euler, exactly like the old gravity()
+		Simulation();
+
+		void setForceSolver(std::unique_ptr<ForceSolver> solver);
+		ForceSolver& forceSolver() { return *solver; }
+
+		void setIntegrator(std::unique_ptr<Integrator> integrator);
+		Integrator& integrator() { return *stepper; }
+
+		// Advances every particle by dt with the current integrator
+		void step(float dt);
+
+		// Call after changing particles by hand so the integrator drops its cached state
+		void particlesChanged() { stepper->reset(); }
+
+		// Re-sorts the particles if reorderInterval steps have passed since the last time, returns true if it did.
+		// step() calls this first; call it yourself before saving per-index state that has to line up after the step.
+		bool reorderIfDue();
+
+	private:
+		std::unique_ptr<ForceSolver> solver;
+		std::unique_ptr<Integrator> stepper;
+		unsigned int stepsSinceReorder;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "SimulationThread.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Longest sleep between checks of the command queue, so input is picked up promptly even at low playing speeds
+static const double MAX_SLEEP = 1.0 / 240.0;
+
+SimulationThread::SimulationThread(Simulation& simulation)
+	: fixedStep(0.25f), maxSubSteps(16), simulation(simulation), running(false), playingSpeed(0.0f), stepCount(0), accumulator(0.0)
+{
+}
+
+double SimulationThread::clock()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SimulationThread::start()
+{
+	if (running)
+	{
+		return;
+	}
+
+	// The renderer has something to draw before the first step finishes
+	accumulator = 0.0;
+	lastX.clear();
+	publish(0.0f);
+	snapshots.update();
+
+	running = true;
+	worker = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop()
+{
+	running = false;
+	if (worker.joinable())
+	{
+		worker.join();
+	}
+}
+
+const SimulationSnapshot& SimulationThread::latest()
+{
+	snapshots.update();
+	return snapshots.readBuffer();
+}
+
+void SimulationThread::apply(const SimulationCommand& command)
+{
+	switch (command.type)
+	{
+		case SimulationCommand::SET_PLAYING_SPEED:
+			playingSpeed = std::max(command.value, 0.0f);
+			break;
+	}
+}
+
+void SimulationThread::publish(float stepLength)
+{
+	const ParticleStore& particles = simulation.particles;
+	std::size_t n = particles.size();
+
+	SimulationSnapshot& snapshot = snapshots.writeBuffer();
+	snapshot.x.assign(particles.x.begin(), particles.x.begin() + n);
+	snapshot.y.assign(particles.y.begin(), particles.y.begin() + n);
+	snapshot.z.assign(particles.z.begin(), particles.z.begin() + n);
+	snapshot.vx.assign(particles.vx.begin(), particles.vx.begin() + n);
+	snapshot.vy.assign(particles.vy.begin(), particles.vy.begin() + n);
+	snapshot.vz.assign(particles.vz.begin(), particles.vz.begin() + n);
+
+	// Blending is only possible when the step kept the same particles
+	if (lastX.size() == n)
+	{
+		snapshot.previousX = lastX;
+		snapshot.previousY = lastY;
+		snapshot.previousZ = lastZ;
+		snapshot.stepLength = stepLength;
+	}
+	else
+	{
+		snapshot.previousX = snapshot.x;
+		snapshot.previousY = snapshot.y;
+		snapshot.previousZ = snapshot.z;
+		snapshot.stepLength = 0.0f;
+	}
+	snapshot.count = n;
+	snapshot.time = simulation.time;
+	snapshot.steps = stepCount;
+	snapshot.wallTime = clock();
+	snapshot.pending = accumulator;
+	snapshot.rate = playingSpeed * REFERENCE_RATE;
+
+	snapshots.publish();
+}
+
+void SimulationThread::run()
+{
+	double last = clock();
+
+	while (running)
+	{
+		SimulationCommand command;
+		while (commands.pop(command))
+		{
+			apply(command);
+		}
+
+		double now = clock();
+		double rate = playingSpeed * REFERENCE_RATE;
+		accumulator += (now - last) * rate;
+		last = now;
+
+		unsigned int subSteps = 0;
+		while (accumulator >= fixedStep && subSteps < maxSubSteps)
+		{
+			// Only the last step of a batch is blended over, so the positions before each step are kept. A re-sort moves
+			// particles between indices, so it has to happen before they are saved.
+			simulation.reorderIfDue();
+			const ParticleStore& particles = simulation.particles;
+			lastX.assign(particles.x.begin(), particles.x.begin() + particles.size());
+			lastY.assign(particles.y.begin(), particles.y.begin() + particles.size());
+			lastZ.assign(particles.z.begin(), particles.z.begin() + particles.size());
+
+			simulation.step(fixedStep);
+			stepCount++;
+			accumulator -= fixedStep;
+			subSteps++;
+		}
+		if (subSteps == maxSubSteps)
+		{
+			accumulator = std::min(accumulator, (double)fixedStep);
+		}
+
+		if (subSteps > 0)
+		{
+			publish(fixedStep);
+		}
+
+		// Sleep until the next step is due
+		double wait = rate > 0.0 ? (fixedStep - accumulator) / rate : MAX_SLEEP;
+		wait = std::min(std::max(wait, 0.0), MAX_SLEEP);
+		std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+	}
+}
@@ -0,0 +1,115 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "AlignedAllocator.h"
+#include "Simulation.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+
+// Copy of the particle state after one physics step, published by the simulation thread for the renderer
+struct SimulationSnapshot
+{
+	AlignedVector<float> x, y, z;
+	AlignedVector<float> vx, vy, vz;
+	// Positions one step earlier, the renderer blends from these towards x, y, z
+	AlignedVector<float> previousX, previousY, previousZ;
+	std::size_t count;
+	// Simulated time and number of steps taken when the copy was made
+	double time;
+	std::uint64_t steps;
+	// Simulated time between previous and current positions (0 when there is nothing to blend)
+	float stepLength;
+	// SimulationThread::clock() at publication, simulated time left in the accumulator then and simulated time
+	// per second of wall time (0 while paused)
+	double wallTime;
+	double pending;
+	double rate;
+
+	SimulationSnapshot() : count(0), time(0.0), steps(0), stepLength(0.0f), wallTime(0.0), pending(0.0), rate(0.0) {}
+
+	// How far to blend from the previous to the current positions at wall time now, in [0, 1]. The picture runs one
+	// step behind the physics so it only ever interpolates between states that exist.
+	float interpolationFactor(double now) const
+	{
+		if (stepLength <= 0.0f)
+		{
+			return 1.0f;
+		}
+		double alpha = (pending + (now - wallTime) * rate) / stepLength;
+		return (float)(alpha < 0.0 ? 0.0 : alpha > 1.0 ? 1.0 : alpha);
+	}
+};
+
+// Input forwarded from the window callbacks to the simulation thread
+struct SimulationCommand
+{
+	enum Type
+	{
+		SET_PLAYING_SPEED
+	};
+
+	Type type;
+	float value;
+};
+
+// Runs a Simulation on its own thread so physics and rendering no longer hold each other up. After every step the
+// particle state is published as a SimulationSnapshot through a lock-free triple buffer; the renderer reads the newest
+// one each frame. Input goes the other way through a lock-free queue and is applied between steps. The simulation
+// belongs to the thread between start() and stop() and must not be touched by anyone else in that time.
+// Physics always advances in steps of fixedStep. Wall time elapsed, scaled by the playing speed, is added to an
+// accumulator and as many whole steps as it holds are taken, so the simulation runs at the same speed whatever the
+// frame rate, and the step size is chosen for accuracy and throughput instead of following the playing speed.
+class SimulationThread
+{
+	public:
+		// Wall-clock rate the playing speed is measured against: a playing speed of s advances the simulation by s every
+		// 1 / REFERENCE_RATE seconds, as the old render loop did at 60 frames per second
+		static constexpr double REFERENCE_RATE = 60.0;
+
+		// Simulated time per physics step
+		float fixedStep;
+		// Most steps taken for one wake-up; if the physics can't keep up the backlog is dropped rather than growing
+		// without bound (the simulation then runs slower than real time instead of freezing)
+		unsigned int maxSubSteps;
+
+		explicit SimulationThread(Simulation& simulation);
+		~SimulationThread() { stop(); }
+
+		void start();
+		void stop();
+
+		// Render thread: queues a command, returns false if the queue is full
+		bool send(const SimulationCommand& command) { return commands.push(command); }
+
+		// Render thread: newest published snapshot, valid until the next call
+		const SimulationSnapshot& latest();
+
+		// Wall clock in seconds shared by the simulation thread and the renderer
+		static double clock();
+
+	private:
+		Simulation& simulation;
+		std::thread worker;
+		std::atomic<bool> running;
+		// Owned by the simulation thread
+		float playingSpeed;
+		std::uint64_t stepCount;
+		// Simulated time owed but not yet stepped
+		double accumulator;
+		// Positions before the latest step, the next snapshot's previous positions
+		AlignedVector<float> lastX, lastY, lastZ;
+
+		TripleBuffer<SimulationSnapshot> snapshots;
+		SpscQueue<SimulationCommand, 256> commands;
+
+		void run();
+		void apply(const SimulationCommand& command);
+		void publish(float stepLength);
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef SOFTENING_H
+#define SOFTENING_H
+
+#include <cmath>
+#include <cstring>
+
+// Shape of the softened force used by the pairwise solvers. Plummer adds eps^2 to every squared separation, so
+// the force is weakened at every distance. The cubic spline of Monaghan and Lattanzio (as used by GADGET) smooths
+// the mass over a sphere of radius h and is exactly Newtonian beyond it, so close encounters stay finite without
+// biasing the forces between well separated particles.
+enum SofteningKernel
+{
+	SOFTENING_PLUMMER,
+	SOFTENING_SPLINE
+};
+
+// Spline radius per unit of Plummer softening; with h = 2.8 eps both kernels have the same central potential depth,
+// so one softening length means roughly the same thing whichever kernel is picked
+static const float SPLINE_RADIUS_PER_SOFTENING = 2.8f;
+
+inline const char* softeningKernelName(SofteningKernel kernel)
+{
+	return kernel == SOFTENING_SPLINE ? "spline" : "plummer";
+}
+
+// Parses "plummer" or "spline", returns false for anything else
+inline bool parseSofteningKernel(const char* name, SofteningKernel& kernel)
+{
+	if (std::strcmp(name, "plummer") == 0)
+	{
+		kernel = SOFTENING_PLUMMER;
+		return true;
+	}
+	if (std::strcmp(name, "spline") == 0)
+	{
+		kernel = SOFTENING_SPLINE;
+		return true;
+	}
+	return false;
+}
+
+// Force factor of the spline kernel: a = m * d * splineForceFactor(r, 1 / h). 0 at r = 0 is fine since d is 0 too.
+// Templated so the double-precision integrators share the same kernel as the float solvers.
+template <typename Real>
+inline Real splineForceFactor(Real r, Real invH)
+{
+	Real u = r * invH;
+	Real invH3 = invH * invH * invH;
+	if (u < Real(0.5))
+	{
+		return invH3 * (Real(32.0 / 3.0) + u * u * (Real(32.0) * u - Real(38.4)));
+	}
+	if (u < Real(1.0))
+	{
+		return invH3 * (Real(64.0 / 3.0) + u * (Real(-48.0) + u * (Real(38.4) - Real(32.0 / 3.0) * u))) - Real(1.0 / 15.0) / (r * r * r);
+	}
+	return Real(1.0) / (r * r * r);
+}
+
+// m * softenedForceFactor(r2, ...) * d is the acceleration towards a point mass m at separation d (|d|^2 = r2).
+// Returns 0 for coincident particles.
+template <typename Real>
+inline Real softenedForceFactor(Real r2, Real softening, SofteningKernel kernel)
+{
+	if (kernel == SOFTENING_SPLINE && softening > Real(0.0))
+	{
+		return r2 > Real(0.0) ? splineForceFactor(std::sqrt(r2), Real(1.0) / (Real(SPLINE_RADIUS_PER_SOFTENING) * softening)) : Real(0.0);
+	}
+
+	Real soft2 = r2 + softening * softening;
+	if (soft2 == Real(0.0))
+	{
+		return Real(0.0);
+	}
+	Real invR = Real(1.0) / std::sqrt(soft2);
+	return invR * invR * invR;
+}
+
+// Potential of the spline kernel: phi = -m * splinePotential(r, 1 / h), the integral of splineForceFactor
+template <typename Real>
+inline Real splinePotential(Real r, Real invH)
+{
+	Real u = r * invH;
+	if (u < Real(0.5))
+	{
+		Real u2 = u * u;
+		return invH * (Real(14.0 / 5.0) + u2 * (Real(-16.0 / 3.0) + u2 * (Real(48.0 / 5.0) - Real(32.0 / 5.0) * u)));
+	}
+	if (u < Real(1.0))
+	{
+		Real u2 = u * u;
+		return invH * (Real(16.0 / 5.0) - Real(1.0 / 15.0) / u + u2 * (Real(-32.0 / 3.0) + u * (Real(16.0) + u * (Real(-48.0 / 5.0) + Real(32.0 / 15.0) * u))));
+	}
+	return Real(1.0) / r;
+}
+
+// Softened 1 / r matching softenedForceFactor: the pair potential is -G m_i m_j softenedInverseDistance(r2, ...).
+// Returns 0 for coincident particles without softening.
+template <typename Real>
+inline Real softenedInverseDistance(Real r2, Real softening, SofteningKernel kernel)
+{
+	if (kernel == SOFTENING_SPLINE && softening > Real(0.0))
+	{
+		return splinePotential(std::sqrt(r2), Real(1.0) / (Real(SPLINE_RADIUS_PER_SOFTENING) * softening));
+	}
+
+	Real soft2 = r2 + softening * softening;
+	return soft2 > Real(0.0) ? Real(1.0) / std::sqrt(soft2) : Real(0.0);
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+#include "AlignedAllocator.h"
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread. Holds CAPACITY - 1 items; push
+// fails instead of blocking when it is full.
+template <class T, std::size_t CAPACITY>
+class SpscQueue
+{
+	public:
+		SpscQueue() : head(0), tail(0) {}
+
+		// Producer
+		bool push(const T& item)
+		{
+			std::size_t t = tail.load(std::memory_order_relaxed);
+			std::size_t next = (t + 1) % CAPACITY;
+			if (next == head.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			items[t] = item;
+			tail.store(next, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer
+		bool pop(T& item)
+		{
+			std::size_t h = head.load(std::memory_order_relaxed);
+			if (h == tail.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			item = items[h];
+			head.store((h + 1) % CAPACITY, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		T items[CAPACITY];
+		// Next item to pop, only written by the consumer
+		alignas(SIMD_ALIGNMENT) std::atomic<std::size_t> head;
+		// Next free slot, only written by the producer
+		alignas(SIMD_ALIGNMENT) std::atomic<std::size_t> tail;
+};
+
+#endif
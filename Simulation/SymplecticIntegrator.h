@@ -0,0 +1,152 @@
+#ifndef SYMPLECTIC_INTEGRATOR_H
+#define SYMPLECTIC_INTEGRATOR_H
+
+#include <cstddef>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#include "Integrator.h"
+
+// Splitting schemes written as alternating kick and drift coefficients (fractions of dt):
+// kick[0], drift[0], kick[1], drift[1], ..., drift[STAGES - 1], kick[STAGES]. The stages are expanded at compile time
+// and zero kicks compile to nothing.
+// Kick-first schemes end on a kick at the new positions, so those accelerations are reused by the next step.
+
+// Kick-drift-kick leapfrog, one force evaluation per step
+struct LeapfrogKDK
+{
+	static constexpr const char* NAME = "leapfrog-kdk";
+	static constexpr int STAGES = 1;
+	static constexpr double kick[STAGES + 1] = { 0.5, 0.5 };
+	static constexpr double drift[STAGES] = { 1.0 };
+};
+
+// Drift-kick-drift leapfrog, one force evaluation per step at the half-step positions
+struct LeapfrogDKD
+{
+	static constexpr const char* NAME = "leapfrog-dkd";
+	static constexpr int STAGES = 2;
+	static constexpr double kick[STAGES + 1] = { 0.0, 1.0, 0.0 };
+	static constexpr double drift[STAGES] = { 0.5, 0.5 };
+};
+
+// Forest-Ruth 4th order, drift first, three force evaluations per step. theta = 1 / (2 - 2^(1/3)).
+struct ForestRuth
+{
+	static constexpr double THETA = 1.35120719195965763405;
+
+	static constexpr const char* NAME = "forest-ruth";
+	static constexpr int STAGES = 4;
+	static constexpr double kick[STAGES + 1] = { 0.0, THETA, 1.0 - 2.0 * THETA, THETA, 0.0 };
+	static constexpr double drift[STAGES] = { 0.5 * THETA, 0.5 * (1.0 - THETA), 0.5 * (1.0 - THETA), 0.5 * THETA };
+};
+
+// Yoshida 4th order: the triple-jump composition of KDK leapfrog steps of w1, w0, w1, three force evaluations per step
+struct Yoshida4
+{
+	static constexpr double W1 = 1.35120719195965763405;
+	static constexpr double W0 = 1.0 - 2.0 * W1;
+
+	static constexpr const char* NAME = "yoshida4";
+	static constexpr int STAGES = 3;
+	static constexpr double kick[STAGES + 1] = { 0.5 * W1, 0.5 * (W1 + W0), 0.5 * (W0 + W1), 0.5 * W1 };
+	static constexpr double drift[STAGES] = { W1, W0, W1 };
+};
+
+// Yoshida 6th order (solution A): seven KDK leapfrog steps of w3, w2, w1, w0, w1, w2, w3, seven force evaluations per step
+struct Yoshida6
+{
+	static constexpr double W1 = -1.17767998417887;
+	static constexpr double W2 = 0.235573213359357;
+	static constexpr double W3 = 0.784513610477560;
+	static constexpr double W0 = 1.0 - 2.0 * (W1 + W2 + W3);
+
+	static constexpr const char* NAME = "yoshida6";
+	static constexpr int STAGES = 7;
+	static constexpr double kick[STAGES + 1] = { 0.5 * W3, 0.5 * (W3 + W2), 0.5 * (W2 + W1), 0.5 * (W1 + W0),
+		0.5 * (W0 + W1), 0.5 * (W1 + W2), 0.5 * (W2 + W3), 0.5 * W3 };
+	static constexpr double drift[STAGES] = { W3, W2, W1, W0, W1, W2, W3 };
+};
+
+// Symplectic integrator instantiated from a Scheme above. The stage sequence is a fold over the stage indices with the
+// coefficients as constants, and the kicks and drifts are the particle store's whole-array updates. When Force names a
+// concrete solver (CentralGravity, DirectGravity, ...) and the simulation's solver is exactly that class, forces come
+// from a direct, non-virtual call to its computeAccelerations, whose kernel is inlined into its own chunk loop; any
+// other solver goes through the ForceSolver interface. Either way there is one call per force evaluation.
+template <class Scheme, class Force = ForceSolver>
+class SymplecticIntegrator : public Integrator
+{
+	public:
+		SymplecticIntegrator() : primed(false) {}
+
+		void step(ParticleStore& particles, ForceSolver& solver, float dt) override
+		{
+			// Accelerations left by the previous step's last kick are still at the current positions
+			bool valid = primed && accelerationSize == particles.size();
+
+			runStages(particles, solver, dt, valid, std::make_index_sequence<Scheme::STAGES + 1>());
+
+			primed = valid;
+			accelerationSize = particles.size();
+		}
+
+		void reset() override { primed = false; }
+		// The cached accelerations are the store's, which move with their particles
+		void particlesReordered() override {}
+		const char* name() const override { return Scheme::NAME; }
+
+	private:
+		bool primed;
+		std::size_t accelerationSize;
+
+		template <std::size_t... S>
+		void runStages(ParticleStore& particles, ForceSolver& solver, float dt, bool& valid, std::index_sequence<S...>)
+		{
+			(stage<S>(particles, solver, dt, valid), ...);
+		}
+
+		// Kick S (skipped when its coefficient is zero), then drift S unless this is the closing kick. The store does
+		// both in double when mixed precision is on.
+		template <std::size_t S>
+		void stage(ParticleStore& particles, ForceSolver& solver, float dt, bool& valid)
+		{
+			if constexpr (Scheme::kick[S] != 0.0)
+			{
+				if (!valid)
+				{
+					evaluate(particles, solver);
+					valid = true;
+				}
+				particles.kick((float)(Scheme::kick[S] * dt));
+			}
+			if constexpr (S < (std::size_t)Scheme::STAGES)
+			{
+				particles.drift((float)(Scheme::drift[S] * dt));
+				valid = false;
+			}
+		}
+
+		void evaluate(ParticleStore& particles, ForceSolver& solver)
+		{
+			if constexpr (std::is_same<Force, ForceSolver>::value)
+			{
+				solver.computeAccelerations(particles);
+			}
+			else
+			{
+				// An exact type match, not a cast through the hierarchy: a subclass may override the evaluation
+				if (typeid(solver) == typeid(Force))
+				{
+					static_cast<Force&>(solver).Force::computeAccelerations(particles);
+				}
+				else
+				{
+					solver.computeAccelerations(particles);
+				}
+			}
+			forceEvaluations += particles.size();
+		}
+};
+
+#endif
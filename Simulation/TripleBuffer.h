@@ -0,0 +1,50 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+#include "AlignedAllocator.h"
+
+// Lock-free hand-over of whole values from one writer thread to one reader thread. The writer fills its back buffer
+// and publishes it, the reader picks up the newest published buffer whenever it likes. Neither side ever waits: the
+// writer can publish many times between two reads (older values are simply skipped) and the reader keeps using the
+// buffer it has until it asks for a new one, so a buffer is never written while it is being read.
+template <class T>
+class TripleBuffer
+{
+	public:
+		TripleBuffer() : shared(1), back(2), front(0) {}
+
+		// Writer: the buffer to fill next
+		T& writeBuffer() { return slots[back]; }
+		// Writer: hands the filled buffer over and takes the spare one back
+		void publish()
+		{
+			back = shared.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+		}
+
+		// Reader: swaps in the newest published buffer, returns false (keeping the current one) if nothing new arrived
+		bool update()
+		{
+			if (!(shared.load(std::memory_order_relaxed) & FRESH))
+			{
+				return false;
+			}
+			front = shared.exchange(front, std::memory_order_acq_rel) & INDEX;
+			return true;
+		}
+		// Reader: the buffer taken by the last update()
+		const T& readBuffer() const { return slots[front]; }
+
+	private:
+		static const unsigned int INDEX = 3;
+		static const unsigned int FRESH = 4;
+
+		T slots[3];
+		// Index of the spare buffer between the two threads, FRESH when the writer published it after the last read
+		alignas(SIMD_ALIGNMENT) std::atomic<unsigned int> shared;
+		alignas(SIMD_ALIGNMENT) unsigned int back;
+		alignas(SIMD_ALIGNMENT) unsigned int front;
+};
+
+#endif
@@ -0,0 +1,188 @@
+#include "WisdomHolmanIntegrator.h"
+
+#include "Kepler.h"
+
+void WisdomHolmanIntegrator::prime(ParticleStore& particles, ForceSolver& solver)
+{
+	std::size_t n = particles.size();
+	std::size_t planets = n - 1;
+
+	sunMass = particles.mass[0];
+	double totalMass = sunMass;
+	double momentumX = sunMass * particles.vx[0], momentumY = sunMass * particles.vy[0], momentumZ = sunMass * particles.vz[0];
+	double weightedX = sunMass * particles.x[0], weightedY = sunMass * particles.y[0], weightedZ = sunMass * particles.z[0];
+	for (std::size_t i = 1; i < n; i++)
+	{
+		double m = particles.mass[i];
+		totalMass += m;
+		momentumX += m * particles.vx[i];
+		momentumY += m * particles.vy[i];
+		momentumZ += m * particles.vz[i];
+		weightedX += m * particles.x[i];
+		weightedY += m * particles.y[i];
+		weightedZ += m * particles.z[i];
+	}
+
+	if (totalMass > 0.0)
+	{
+		centerX = weightedX / totalMass;
+		centerY = weightedY / totalMass;
+		centerZ = weightedZ / totalMass;
+		centerVX = momentumX / totalMass;
+		centerVY = momentumY / totalMass;
+		centerVZ = momentumZ / totalMass;
+	}
+	else
+	{
+		centerX = particles.x[0];
+		centerY = particles.y[0];
+		centerZ = particles.z[0];
+		centerVX = particles.vx[0];
+		centerVY = particles.vy[0];
+		centerVZ = particles.vz[0];
+	}
+
+	x.resize(planets);
+	y.resize(planets);
+	z.resize(planets);
+	vx.resize(planets);
+	vy.resize(planets);
+	vz.resize(planets);
+	mass.resize(planets);
+	for (std::size_t i = 0; i < planets; i++)
+	{
+		x[i] = (double)particles.x[i + 1] - particles.x[0];
+		y[i] = (double)particles.y[i + 1] - particles.y[0];
+		z[i] = (double)particles.z[i + 1] - particles.z[0];
+		vx[i] = particles.vx[i + 1] - centerVX;
+		vy[i] = particles.vy[i + 1] - centerVY;
+		vz[i] = particles.vz[i + 1] - centerVZ;
+		mass[i] = particles.mass[i + 1];
+	}
+
+	interactionAccelerations(particles, solver);
+	primed = true;
+}
+
+void WisdomHolmanIntegrator::interactionAccelerations(ParticleStore& particles, ForceSolver& solver)
+{
+	float sun = particles.mass[0];
+	particles.mass[0] = 0.0f;
+	solver.computeAccelerations(particles);
+	particles.mass[0] = sun;
+
+	forceEvaluations += particles.size();
+}
+
+void WisdomHolmanIntegrator::kick(const ParticleStore& particles, double dt)
+{
+	for (std::size_t i = 0; i < x.size(); i++)
+	{
+		vx[i] += particles.ax[i + 1] * dt;
+		vy[i] += particles.ay[i + 1] * dt;
+		vz[i] += particles.az[i + 1] * dt;
+	}
+}
+
+void WisdomHolmanIntegrator::jump(double dt)
+{
+	if (sunMass == 0.0)
+	{
+		return;
+	}
+
+	// The sun's share of the momentum moves every heliocentric position together
+	double momentumX = 0.0, momentumY = 0.0, momentumZ = 0.0;
+	for (std::size_t i = 0; i < x.size(); i++)
+	{
+		momentumX += mass[i] * vx[i];
+		momentumY += mass[i] * vy[i];
+		momentumZ += mass[i] * vz[i];
+	}
+
+	double scale = dt / sunMass;
+	for (std::size_t i = 0; i < x.size(); i++)
+	{
+		x[i] += momentumX * scale;
+		y[i] += momentumY * scale;
+		z[i] += momentumZ * scale;
+	}
+}
+
+void WisdomHolmanIntegrator::store(ParticleStore& particles) const
+{
+	double totalMass = sunMass;
+	double weightedX = 0.0, weightedY = 0.0, weightedZ = 0.0;
+	double momentumX = 0.0, momentumY = 0.0, momentumZ = 0.0;
+	for (std::size_t i = 0; i < x.size(); i++)
+	{
+		totalMass += mass[i];
+		weightedX += mass[i] * x[i];
+		weightedY += mass[i] * y[i];
+		weightedZ += mass[i] * z[i];
+		momentumX += mass[i] * vx[i];
+		momentumY += mass[i] * vy[i];
+		momentumZ += mass[i] * vz[i];
+	}
+
+	// Sun position from the barycentre, sun velocity from the total barycentric momentum being zero
+	double sunX = centerX, sunY = centerY, sunZ = centerZ;
+	double sunVX = centerVX, sunVY = centerVY, sunVZ = centerVZ;
+	if (totalMass > 0.0)
+	{
+		sunX -= weightedX / totalMass;
+		sunY -= weightedY / totalMass;
+		sunZ -= weightedZ / totalMass;
+	}
+	if (sunMass > 0.0)
+	{
+		sunVX -= momentumX / sunMass;
+		sunVY -= momentumY / sunMass;
+		sunVZ -= momentumZ / sunMass;
+	}
+
+	particles.x[0] = (float)sunX;
+	particles.y[0] = (float)sunY;
+	particles.z[0] = (float)sunZ;
+	particles.vx[0] = (float)sunVX;
+	particles.vy[0] = (float)sunVY;
+	particles.vz[0] = (float)sunVZ;
+	for (std::size_t i = 0; i < x.size(); i++)
+	{
+		particles.x[i + 1] = (float)(x[i] + sunX);
+		particles.y[i + 1] = (float)(y[i] + sunY);
+		particles.z[i + 1] = (float)(z[i] + sunZ);
+		particles.vx[i + 1] = (float)(vx[i] + centerVX);
+		particles.vy[i + 1] = (float)(vy[i] + centerVY);
+		particles.vz[i + 1] = (float)(vz[i] + centerVZ);
+	}
+}
+
+void WisdomHolmanIntegrator::step(ParticleStore& particles, ForceSolver& solver, float dt)
+{
+	std::size_t n = particles.size();
+	if (n == 0)
+	{
+		return;
+	}
+
+	if (!primed || x.size() != n - 1)
+	{
+		prime(particles, solver);
+	}
+
+	kick(particles, 0.5 * dt);
+	jump(0.5 * dt);
+	keplerDrift(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), x.size(), GRAVITATIONAL_CONSTANT * sunMass, dt);
+	jump(0.5 * dt);
+
+	centerX += centerVX * dt;
+	centerY += centerVY * dt;
+	centerZ += centerVZ * dt;
+
+	// Mutual forces only depend on separations, so the inertial positions are good enough for the solver
+	store(particles);
+	interactionAccelerations(particles, solver);
+	kick(particles, 0.5 * dt);
+	store(particles);
+}
@@ -0,0 +1,44 @@
+#ifndef WISDOM_HOLMAN_INTEGRATOR_H
+#define WISDOM_HOLMAN_INTEGRATOR_H
+
+#include <vector>
+
+#include "Integrator.h"
+
+// Wisdom-Holman symplectic map for systems dominated by the particle at index 0 (the sun). Works in democratic
+// heliocentric coordinates: positions relative to the sun, velocities relative to the barycentre. Each step is
+// interaction kick (dt/2), jump (dt/2), Kepler drift about the sun (dt), jump (dt/2), interaction kick (dt/2), so the
+// sun's pull is integrated exactly and only the much weaker mutual forces are discretised. The force solver is asked
+// for the mutual part only by zeroing the sun's mass for the call; with CentralGravity that part is zero and every
+// orbit is followed exactly at any step size. Particle masses still move the sun around the barycentre, so massive
+// particles under CentralGravity see a wobbling sun rather than the fixed one of the old model.
+// The Kepler drift follows the unsoftened sun, so solver softening only applies to the mutual forces.
+// The state is kept in double between steps and copied into the float particle arrays after each one.
+class WisdomHolmanIntegrator : public Integrator
+{
+	public:
+		WisdomHolmanIntegrator() : primed(false) {}
+
+		void step(ParticleStore& particles, ForceSolver& solver, float dt) override;
+		void reset() override { primed = false; }
+		const char* name() const override { return "wisdom-holman"; }
+
+	private:
+		bool primed;
+		double sunMass;
+		// Barycentre position and velocity
+		double centerX, centerY, centerZ;
+		double centerVX, centerVY, centerVZ;
+		// Heliocentric positions and barycentric velocities of particles 1..n-1
+		std::vector<double> x, y, z, vx, vy, vz, mass;
+
+		void prime(ParticleStore& particles, ForceSolver& solver);
+		// Mutual accelerations at the current positions, left in particles.ax/ay/az
+		void interactionAccelerations(ParticleStore& particles, ForceSolver& solver);
+		void kick(const ParticleStore& particles, double dt);
+		void jump(double dt);
+		// Writes inertial positions and velocities back into the particle arrays
+		void store(ParticleStore& particles) const;
+};
+
+#endif
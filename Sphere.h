@@ -3,85 +3,160 @@
 #define SPHERE_H
 
 #include <iostream>
+#include <vector>
+#include <stdint.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <math.h>
 
+#include "MeshOptimizer.h"
+
+// Range of Sphere::indices holding one level of detail
+struct SphereLod {
+    int segments;       // sectors and stacks of this level
+    GLsizei indexCount;
+    GLsizeiptr indexOffset; // in bytes, for glDrawElements
+};
+
+// Compact vertex: the unit-sphere position as signed normalized 16-bit integers, read as a vec3 in [-1, 1].
+// 8 bytes (the 4th component pads to 4-byte alignment) instead of 12 for three floats. No normal is stored: on a unit
+// sphere it equals the position, so a shader that wants one uses aPos.
+struct SphereVertex {
+    GLshort position[4];
+};
+
+// A chain of unit UV spheres from coarse to fine, all in one shared VBO/EBO; instances scale them to their radius.
+// Each level's indices already point at its own vertices, so any level is drawn with a plain glDrawElements over its
+// index range. Every level goes through MeshOptimizer.h before upload: quantized, welded (the seam and pole copies
+// become one vertex), reordered for the post-transform cache and then for vertex fetch. Indices are 16-bit whenever
+// the whole chain has few enough vertices, which it does.
 class Sphere {
 public:
-    static const int num_sectors = 30; // horizontal slices
-    static const int num_stacks = 30;  // vertical slices
-    std::vector<float> vertices;
+    static const int lod_count = 5;
+    // Sectors (horizontal slices) and stacks (vertical slices) of each level, coarsest first
+    static constexpr int lod_segments[lod_count] = { 4, 8, 16, 32, 64 };
+    std::vector<SphereVertex> vertices;
     std::vector<GLuint> indices;
+    SphereLod lods[lod_count];
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, whichever the element buffer was uploaded as
+    GLenum indexType;
     GLuint vbo, ebo; // Vertex Buffer Object and Element Buffer Object
 
-    Sphere(float radius) {
-        generateVertices(radius);
-        generateIndices();
+    Sphere() {
+        for (int level = 0; level < lod_count; ++level) {
+            lods[level].segments = lod_segments[level];
+            appendLevel(lod_segments[level], lods[level]);
+        }
+
+        indexType = vertices.size() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        GLsizeiptr indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        for (int level = 0; level < lod_count; ++level) {
+            // appendLevel recorded the offset in indices, the buffer wants bytes
+            lods[level].indexOffset *= indexSize;
+        }
         createBuffers();
     }
 
+    // Coarsest level whose silhouette stays within half a pixel of the true circle for a sphere covering
+    // projectedRadius pixels on screen. n segments miss the circle by r (1 - cos(pi / n)) at most.
+    int levelFor(float projectedRadius) const {
+        for (int level = 0; level < lod_count; ++level) {
+            if (projectedRadius * (1.0f - cosf((float)M_PI / lod_segments[level])) <= 0.5f) {
+                return level;
+            }
+        }
+        return lod_count - 1;
+    }
+
     ~Sphere() {
         glDeleteBuffers(1, &vbo);
         glDeleteBuffers(1, &ebo);
     }
 
-    void draw() {
+    // Points attribute 0 of the bound VAO at the positions in vbo
+    void bindPositions() const {
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(SphereVertex), 0);
+    }
+
+    // Draws one level, the finest by default
+    void draw(int level = lod_count - 1) {
+        bindPositions();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glDrawElements(GL_TRIANGLES, lods[level].indexCount, indexType, (void*)lods[level].indexOffset);
         glDisableVertexAttribArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
 
 private:
-    void generateVertices(float radius) {
+    // Builds one level, runs it through the mesh optimizer and appends it; lod.indexOffset is left in indices
+    void appendLevel(int segments, SphereLod& lod) {
+        std::vector<SphereVertex> levelVertices;
+        std::vector<GLuint> levelIndices;
+        generateVertices(levelVertices, segments, segments);
+        generateIndices(levelIndices, segments, segments);
+
+        weldVertices(levelVertices, levelIndices, [](const SphereVertex& v) {
+            return (uint64_t)(uint16_t)v.position[0] | (uint64_t)(uint16_t)v.position[1] << 16 | (uint64_t)(uint16_t)v.position[2] << 32;
+        });
+        optimizeVertexCache(levelIndices, levelVertices.size());
+        optimizeVertexFetch(levelVertices, levelIndices);
+
+        GLuint baseVertex = (GLuint)vertices.size();
+        lod.indexOffset = (GLsizeiptr)indices.size();
+        lod.indexCount = (GLsizei)levelIndices.size();
+        vertices.insert(vertices.end(), levelVertices.begin(), levelVertices.end());
+        indices.reserve(indices.size() + levelIndices.size());
+        for (GLuint index : levelIndices) {
+            indices.push_back(baseVertex + index);
+        }
+    }
+
+    static void generateVertices(std::vector<SphereVertex>& out, int num_sectors, int num_stacks) {
         float sectorStep = 2 * M_PI / num_sectors;
         float stackStep = M_PI / num_stacks;
+        out.resize((num_stacks + 1) * (num_sectors + 1));
 
+        SphereVertex* vertex = out.data();
         for (int i = 0; i <= num_stacks; ++i) {
             float stackAngle = M_PI / 2 - i * stackStep; // starting from pi/2 to -pi/2
-            float xy = radius * cosf(stackAngle);       // r * cos(u)
-            float z = radius * sinf(stackAngle);        // r * sin(u)
+            float xy = cosf(stackAngle);                // cos(u)
+            float z = sinf(stackAngle);                 // sin(u)
 
             // add (sectorCount+1) vertices per stack
-            // the first and last vertices have same position and normal, but different tex coords
-            for (int j = 0; j <= num_sectors; ++j) {
+            // the first and last vertices have the same position, welding merges them
+            for (int j = 0; j <= num_sectors; ++j, ++vertex) {
                 float sectorAngle = j * sectorStep; // starting from 0 to 2pi
 
                 // vertex position (x, y, z)
-                float x = xy * cosf(sectorAngle); // r * cos(u) * cos(v)
-                float y = xy * sinf(sectorAngle); // r * cos(u) * sin(v)
-                vertices.push_back(x);
-                vertices.push_back(y);
-                vertices.push_back(z);
+                vertex->position[0] = quantizeSnorm16(xy * cosf(sectorAngle)); // cos(u) * cos(v)
+                vertex->position[1] = quantizeSnorm16(xy * sinf(sectorAngle)); // cos(u) * sin(v)
+                vertex->position[2] = quantizeSnorm16(z);
+                vertex->position[3] = 0;
             }
         }
     }
 
-    void generateIndices() {
-        int k1, k2;
+    static void generateIndices(std::vector<GLuint>& out, int num_sectors, int num_stacks) {
+        // 2 triangles per sector except the single ones at the poles
+        out.reserve(6 * num_sectors * (num_stacks - 1));
+        GLuint k1, k2;
         for (int i = 0; i < num_stacks; ++i) {
-            k1 = i * (num_sectors + 1);     // beginning of current stack
-            k2 = k1 + num_sectors + 1;      // beginning of next stack
+            k1 = i * (num_sectors + 1); // beginning of current stack
+            k2 = k1 + num_sectors + 1;  // beginning of next stack
 
             for (int j = 0; j < num_sectors; ++j, ++k1, ++k2) {
                 // 2 triangles per sector excluding first and last stacks
                 // k1 => k2 => k1+1
                 if (i != 0) {
-                    indices.push_back(k1);
-                    indices.push_back(k2);
-                    indices.push_back(k1 + 1);
+                    out.insert(out.end(), { k1, k2, k1 + 1 });
                 }
 
                 // k1+1 => k2 => k2+1
                 if (i != (num_stacks - 1)) {
-                    indices.push_back(k1 + 1);
-                    indices.push_back(k2);
-                    indices.push_back(k2 + 1);
+                    out.insert(out.end(), { k1 + 1, k2, k2 + 1 });
                 }
             }
         }
@@ -90,11 +165,17 @@ private:
     void createBuffers() {
         glGenBuffers(1, &vbo);
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(SphereVertex), vertices.data(), GL_STATIC_DRAW);
 
         glGenBuffers(1, &ebo);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+        if (indexType == GL_UNSIGNED_SHORT) {
+            std::vector<GLushort> narrow(indices.begin(), indices.end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, narrow.size() * sizeof(GLushort), narrow.data(), GL_STATIC_DRAW);
+        }
+        else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        }
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
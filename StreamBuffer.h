@@ -0,0 +1,181 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <cstring>
+
+#include <glad/glad.h>
+
+// glBufferStorage is GL 4.4 / ARB_buffer_storage, newer than the 3.3 core profile the bundled glad loads
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// Buffer the CPU writes into every frame while the GPU is still reading earlier frames. The storage is split into
+// REGIONS equal regions used in turn, and each region gets a fence once the draws reading it are submitted, so the CPU
+// only ever waits on a region the GPU used REGIONS frames ago and normally doesn't wait at all.
+// With glBufferStorage the whole buffer is mapped once, persistently and coherently, and begin() hands out a pointer
+// straight into it: whatever fills the frame writes into GPU-visible memory with no intermediate copy and no driver
+// call. Without it (plain GL 3.3) each region is mapped unsynchronized for the frame instead, which still avoids the
+// reallocation and the stall of glBufferData, at the cost of one map and unmap per frame.
+class StreamBuffer
+{
+	public:
+		static const int REGIONS = 3;
+
+		// Looks up glBufferStorage, call once after gladLoadGLLoader with the same loader
+		static void loadBufferStorage(GLADloadproc load)
+		{
+			bufferStorage() = NULL;
+
+			GLint major = 0, minor = 0;
+			glGetIntegerv(GL_MAJOR_VERSION, &major);
+			glGetIntegerv(GL_MINOR_VERSION, &minor);
+			bool supported = major > 4 || (major == 4 && minor >= 4);
+
+			GLint extensions = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+			for (GLint i = 0; i < extensions && !supported; i++)
+			{
+				supported = std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0;
+			}
+
+			if (supported)
+			{
+				bufferStorage() = (PFNBUFFERSTORAGEPROC)load("glBufferStorage");
+			}
+		}
+
+		explicit StreamBuffer(GLenum target) : target(target), buffer(0), regionSize(0), region(0), mapped(NULL), current(NULL)
+		{
+			for (int r = 0; r < REGIONS; r++)
+			{
+				fences[r] = 0;
+			}
+		}
+
+		~StreamBuffer() { release(); }
+
+		// Waits until the next region is free and returns it for writing size bytes. The buffer only grows (to twice the
+		// request, so a slowly growing particle count doesn't reallocate every frame); the old one is dropped when the
+		// GPU is done with it. Leaves the buffer bound to the target.
+		void* begin(GLsizeiptr size)
+		{
+			if (size > regionSize)
+			{
+				allocate(size * 2);
+			}
+
+			region = (region + 1) % REGIONS;
+			if (fences[region] != 0)
+			{
+				// The wait only times out if the GPU is REGIONS frames behind, keep flushing until it catches up
+				while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+				{
+				}
+				glDeleteSync(fences[region]);
+				fences[region] = 0;
+			}
+
+			glBindBuffer(target, buffer);
+			if (mapped != NULL)
+			{
+				current = mapped + offset();
+			}
+			else
+			{
+				current = (char*)glMapBufferRange(target, offset(), regionSize,
+					GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			}
+			return current;
+		}
+
+		// Ends the writes to the region begin() returned, before the draws that read it. Leaves the buffer bound.
+		void commit()
+		{
+			glBindBuffer(target, buffer);
+			if (mapped == NULL && current != NULL)
+			{
+				glUnmapBuffer(target);
+			}
+			current = NULL;
+		}
+
+		// Call once every draw reading the current region has been submitted
+		void fence()
+		{
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+
+		GLuint id() const { return buffer; }
+		// Byte offset of the current region in the buffer, for attribute pointers and draw offsets
+		GLintptr offset() const { return (GLintptr)region * regionSize; }
+		bool persistent() const { return mapped != NULL; }
+
+	private:
+		GLenum target;
+		GLuint buffer;
+		GLsizeiptr regionSize;
+		int region;
+		GLsync fences[REGIONS];
+		// Base of the persistent mapping (NULL without glBufferStorage) and the region handed out by begin()
+		char* mapped;
+		char* current;
+
+		static PFNBUFFERSTORAGEPROC& bufferStorage()
+		{
+			static PFNBUFFERSTORAGEPROC function = NULL;
+			return function;
+		}
+
+		void allocate(GLsizeiptr size)
+		{
+			release();
+
+			regionSize = size;
+			glGenBuffers(1, &buffer);
+			glBindBuffer(target, buffer);
+
+			if (bufferStorage() != NULL)
+			{
+				GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				bufferStorage()(target, REGIONS * regionSize, NULL, flags);
+				mapped = (char*)glMapBufferRange(target, 0, REGIONS * regionSize, flags);
+			}
+			else
+			{
+				glBufferData(target, REGIONS * regionSize, NULL, GL_STREAM_DRAW);
+			}
+		}
+
+		void release()
+		{
+			for (int r = 0; r < REGIONS; r++)
+			{
+				if (fences[r] != 0)
+				{
+					glDeleteSync(fences[r]);
+					fences[r] = 0;
+				}
+			}
+
+			if (buffer != 0)
+			{
+				if (mapped != NULL)
+				{
+					glBindBuffer(target, buffer);
+					glUnmapBuffer(target);
+					mapped = NULL;
+				}
+				// GL keeps the storage alive until pending draws that read it have finished
+				glDeleteBuffers(1, &buffer);
+				buffer = 0;
+			}
+			regionSize = 0;
+		}
+};
+
+#endif
@@ -2,8 +2,7 @@
 out vec4 FragColor;
   
 in vec3 ourColor;
-
-uniform vec3 ampColor;
+in vec3 ampColor;
 
 
 void main()
@@ -2,17 +2,22 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 layout (location = 2) in vec3 aColor;
+// Per instance: particle position, sphere radius and tint
+layout (location = 3) in vec3 aOffset;
+layout (location = 4) in float aScale;
+layout (location = 5) in vec3 aAmpColor;
 
 out vec3 ourColor;
+out vec3 ampColor;
 
 uniform mat4 transform;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+	gl_Position = projection * view * vec4(aPos * aScale + aOffset, 1.0f);
 	ourColor = aPos;
+	ampColor = aAmpColor;
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 viewPosition;
+flat in vec3 sphereCenter;
+flat in float sphereRadius;
+flat in vec3 ampColor;
+
+uniform mat4 projection;
+
+void main()
+{
+	// Nearest intersection of the camera ray through this fragment with the sphere, |t dir - c|^2 = r^2
+	vec3 direction = normalize(viewPosition);
+	float b = dot(direction, sphereCenter);
+	float discriminant = b * b - dot(sphereCenter, sphereCenter) + sphereRadius * sphereRadius;
+	if (discriminant < 0.0f)
+	{
+		discard;
+	}
+	vec3 hit = direction * (b - sqrt(discriminant));
+
+	// Depth of the surface point rather than of the quad, so impostors intersect each other like real spheres
+	vec4 clip = projection * vec4(hit, 1.0f);
+	gl_FragDepth = (clip.z / clip.w) * 0.5f + 0.5f;
+
+	FragColor = vec4(vec3(1.0f, 0.4f, 0.7f) - vec3(0.3f, 0.5f, 0.5f) * ampColor, 1.0f);
+}
\ No newline at end of file
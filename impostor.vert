@@ -0,0 +1,39 @@
+#version 330 core
+// Per instance: particle position, sphere radius and tint (same instance buffer as default.vert)
+layout (location = 3) in vec3 aOffset;
+layout (location = 4) in float aScale;
+layout (location = 5) in vec3 aAmpColor;
+
+// View-space point on the quad, the fragment shader casts a ray from the camera through it
+out vec3 viewPosition;
+flat out vec3 sphereCenter;
+flat out float sphereRadius;
+flat out vec3 ampColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	// Corner of the quad from the vertex index, drawn as a 4-vertex triangle strip
+	vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0f - 1.0f;
+
+	vec3 center = (view * vec4(aOffset, 1.0f)).xyz;
+	float distance2 = dot(center, center);
+	float radius2 = aScale * aScale;
+
+	// The quad faces the camera through the sphere's centre and is just big enough to hold its silhouette:
+	// a sphere seen from distance d covers a cone of half-angle asin(r / d), which cuts this plane at r d / sqrt(d^2 - r^2)
+	vec3 toSphere = normalize(center);
+	vec3 side = abs(toSphere.y) < 0.999f ? normalize(cross(toSphere, vec3(0.0f, 1.0f, 0.0f))) : vec3(1.0f, 0.0f, 0.0f);
+	vec3 up = cross(side, toSphere);
+	float halfSize = aScale * sqrt(distance2 / max(distance2 - radius2, 1e-6f));
+
+	viewPosition = center + (side * corner.x + up * corner.y) * halfSize;
+	sphereCenter = center;
+	sphereRadius = aScale;
+	ampColor = aAmpColor;
+
+	// Spheres around the camera would need a quad behind it, they are left out
+	gl_Position = distance2 > radius2 ? projection * vec4(viewPosition, 1.0f) : vec4(0.0f, 0.0f, 2.0f, 1.0f);
+}
\ No newline at end of file